@@ -3,6 +3,27 @@
 #include <cstring>
 #include <fstream>
 #include <filesystem>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cctype>
+#include <cstdlib>
+#include <regex>
+#include <map>
+#include <set>
+#include <cmath>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+
+#ifdef LINUX
+    #include <sys/inotify.h>
+    #include <poll.h>
+    #include <unistd.h>
+    #include <sys/resource.h>
+    #include <sys/wait.h>
+#endif
 
 #define TYPE_UNKNOWN -1
 #define TYPE_CLANG 0
@@ -13,6 +34,57 @@
 #define PROC_TYPE_32BIT 0       //Uses -m32 to insure that 32 bit code is generated
 #define PROC_TYPE_64BIT 1       //Uses -m64 to insure that 64 bit code is generated
 
+#define CONFIG_DEBUG 0
+#define CONFIG_RELEASE 1
+#define CONFIG_INSTRUMENTED 2   //Optimized build that writes profiles when it is run. Only used with -PGO
+#define CONFIG_PGO 3            //Optimized build that uses the profiles from the instrumented build. Only used with -PGO
+#define CONFIG_RELWITHDEBINFO 4 //Optimized build with debug info for profiling
+
+#define ARCH_DEFAULT 0          //No -march flag. The compiler's default target is used
+#define ARCH_NATIVE 1           //Targets the cpu the project is built on
+#define ARCH_X86_64_V2 2        //SSE4.2 and POPCNT
+#define ARCH_X86_64_V3 3        //AVX2, BMI2, and FMA
+#define ARCH_X86_64_V4 4        //AVX-512
+#define ARCH_MULTI 5            //Builds the release executable for each level and a launcher that picks the best one
+
+#define LTO_NONE 0              //No link time optimization
+#define LTO_FULL 1              //Uses -flto (or /GL and /LTCG for msvc) for the release build
+#define LTO_THIN 2              //Uses -flto=thin with a cache for clang. Other compilers use their normal link time optimization
+
+#define LINKER_AUTO -1           //Picks the fastest linker found on the PATH. Only on Linux
+#define LINKER_DEFAULT 0        //Lets the compiler pick the linker
+#define LINKER_LLD 1
+#define LINKER_MOLD 2
+#define LINKER_GOLD 3
+
+#define CACHE_NONE 0
+#define CACHE_CCACHE 1
+#define CACHE_SCCACHE 2
+
+#define JSON_NULL 0
+#define JSON_BOOL 1
+#define JSON_NUMBER 2
+#define JSON_STRING 3
+#define JSON_ARRAY 4
+#define JSON_OBJECT 5
+
+#define TARGET_EXECUTABLE 0
+#define TARGET_STATIC 1
+#define TARGET_SHARED 2
+
+#define LINK_JOB_MB 2048        //Memory a link is expected to use when picking how many run at once
+#define LTO_LINK_JOB_MB 6144    //Memory a link with link time optimization is expected to use
+#define HEAVY_JOB_MB 4096       //Memory a source tagged as heavy is expected to use when compiled
+
+#define WRITE_UNCHANGED 0       //The file already had the same content and was left alone
+#define WRITE_CHANGED 1
+#define WRITE_FAILED 2
+
+#define REPORT_COUNT 10         //How many entries each section of a report lists
+
+#define BENCH_NOISE_SCALE 2.0   //How many deviations apart two medians must be before the change is more than noise
+#define WATCH_DEBOUNCE_MS 150 //How long the src folder must be quiet before the watch mode regenerates
+
 #define max(a,b) (((a)<(b))? (b) : (a))
 
 //note that startDir is appended with ./ later on.
@@ -27,10 +99,31 @@ bool includeResourceFile = false;
 bool isStaticLibrary = false;
 bool isDynamicLibrary = false;
 bool extraDebugOptions = false;
+bool fastDebugOptions = false;
+bool includeBenchmarks = false;
 bool vscodeOptions = false;
 bool isGuiApplication = false;
 
+//number of unity (jumbo) files to batch the sources into. 0 disables it.
+int unityBuildCount = 0;
+
+//header to precompile once per configuration. Empty disables it.
+std::string pchHeader = "";
+
 int processorType = PROC_TYPE_UNKNOWN;
+int archType = ARCH_DEFAULT;
+int ltoType = LTO_NONE;
+
+#ifdef LINUX
+    int linkerType = LINKER_AUTO;
+#else
+    int linkerType = LINKER_DEFAULT;
+#endif
+bool profileGuided = false;
+int compilerCacheType = CACHE_NONE;
+
+//runs ninja on the debug build after every change in watch mode
+bool watchBuild = false;
 
 #ifdef LINUX
     bool generateBatch = false;
@@ -41,9 +134,80 @@ int processorType = PROC_TYPE_UNKNOWN;
 char compilerType = TYPE_CLANG;
 bool compilerTypeSet = false;
 
+//adds -ftime-trace to the objects so -report-build-times can read them
+bool traceBuild = false;
+
+//how many links and heavy compiles ninja runs at once. 0 picks them from the cores and memory
+int linkJobs = 0;
+int heavyJobs = 0;
+
+//sources that match a pattern in .cppsheavy and are compiled in the heavy pool
+std::set<std::string> heavySources;
+
+//compiles .cppm and .ixx module units with c++20 and scans every source for the modules it imports
+bool useModules = false;
+
+//the build files run this tool to order the module builds
+std::string toolPath = "cppPS";
+
+//slowdown in percent that -compare-bench treats as a regression
+double benchThreshold = 5;
+
+//the options given on the command line. -u only uses the saved value of an option that was not given.
+std::set<std::string> givenOptions;
+
+//the linker was found by LINKER_AUTO. It is saved as LINKER_AUTO so it is looked for again.
+bool linkerFound = false;
+
 
 namespace fs = std::filesystem;
 
+//a target from targets.txt
+struct Target
+{
+    std::string name = "";
+    char type = TARGET_EXECUTABLE;
+    std::vector<std::string> sourceDirs;
+    std::vector<std::string> dependencies;
+};
+
+//empty when the project has no targets.txt and builds a single executable
+std::vector<Target> projectTargets;
+
+//what a folder in src held the last time it was read. The names are relative to the folder.
+struct DirState
+{
+    long long writeTime = 0;
+    std::vector<std::string> files;
+    std::vector<std::string> subDirs;
+};
+
+//the folders of src from .cppps/state. Only folders whose modified time changed are read again.
+std::map<std::string, DirState> dirIndex;
+
+//the .cppsignore patterns and module option the index was made with. The index is thrown away when they change.
+std::string dirIndexFilter = "";
+
+struct JsonValue
+{
+    char type = JSON_NULL;
+    bool boolean = false;
+    double number = 0;
+    std::string text = "";
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* get(const std::string& name) const
+    {
+        for(const std::pair<std::string, JsonValue>& member : members)
+        {
+            if(member.first == name)
+                return &member.second;
+        }
+        return nullptr;
+    }
+};
+
 void helpFunc()
 {
 
@@ -54,31 +218,54 @@ void helpFunc()
 
     std::cout << std::endl;
     std::cout << "----------------------------" << std::endl;
-    std::cout << "-u    Update the project at the target directory." << std::endl;
+    std::cout << "-u    Update the project at the target directory. Uses the options saved in .cppps/state." << std::endl;
+    std::cout << "-Reset_Options  With -u, ignores the saved options and only uses the ones given." << std::endl;
     std::cout << "-f    Change the target directory for this tool." << std::endl;
     std::cout << "-n    Sets the project's name to something other than output." << std::endl;
     std::cout << "-i    Sets the environment variables that this program depends on." << std::endl;
     std::cout << "-c    Sets the compiler used to compile allowing custom compilers." << std::endl;
     std::cout << "-ct   Sets the compiler type to a pre-defined one for automatic setup." << std::endl;
+    std::cout << "-report-build-times  Prints the slowest objects, headers, and template instantiations from the last build." << std::endl;
+    std::cout << "-bench-generator [N]  Times the scan and build file generation on made up trees of up to N (100000) files. Linux only." << std::endl;
+    std::cout << "-analyze-includes  Prints the headers that the most objects include and the compile time they cause to rebuild." << std::endl;
+    std::cout << "-compare-bench <baseline.json> <candidate.json>  Compares two benchmark results and fails when one is slower." << std::endl;
+    std::cout << "-threshold <percent>  How much slower a benchmark can be before -compare-bench fails. Default is 5." << std::endl;
+    std::cout << "-watch Keeps running and updates the project when files are added or removed in the src folder. (Linux only)" << std::endl;
 
     std::cout << std::endl;
     std::cout << "----------------------------" << std::endl;
     std::cout << "-32BIT                Sets the processor architecture to be 32 bit. (Uses flags to ensure 32 bit code)" << std::endl;
     std::cout << "-64BIT                Sets the processor architecture to be 64 bit. (Uses flags to ensure 64 bit code)" << std::endl;
     std::cout << "-GENERAL_PROCESSOR    Sets the processor architecture to be based on the compiler. (No flags used. Compiler generates code for the current platform.)" << std::endl;
+    std::cout << "-ARCH level           Sets the instruction set for the optimized builds. native, x86-64-v2, x86-64-v3, x86-64-v4, or multi." << std::endl;
+    std::cout << "                      multi builds the release executable for each level with a launcher that starts the best one." << std::endl;
 
     std::cout << std::endl;
     std::cout << "----------------------------" << std::endl;
     std::cout << "Additional Options:" << std::endl;
     std::cout << "-Include_Windows   Includes the windows headers and libraries for both x86 and x64." << std::endl;
     std::cout << "-Exclude_Console   Creates an application that does not start with a console window. Useful in a Windows environment." << std::endl;
-    std::cout << "-Static_Library    Sets the project up for building a static library. Other builds are still included." << std::endl;
-    std::cout << "-Dynamic_Library   Sets the project up for building a dynamic library. Other builds are still included." << std::endl;
+    std::cout << "-Static_Library    Also builds a static library of the project in exportStaticLib. Other builds are still included." << std::endl;
+    std::cout << "-Dynamic_Library   Also builds a dynamic library of the project in exportDynamicLib. Other builds are still included." << std::endl;
     std::cout << "-Ext_Debug_Flags   Adds additional debug options to the debug build of the project." << std::endl;
+    std::cout << "-Link_Jobs N       How many links can run at once. By default it is picked from the cores and memory." << std::endl;
+    std::cout << "-Heavy_Jobs N      How many sources listed in .cppsheavy can compile at once. By default it is picked from the cores and memory." << std::endl;
+    std::cout << "-Modules           Uses c++20 and builds .cppm and .ixx module units in the right order. Needs clang 16, gcc 14, or msvc." << std::endl;
+    std::cout << "-Fast_Debug        Uses split and compressed debug info and a gdb index for builds with debug info." << std::endl;
+    std::cout << "-Benchmarks        Adds a bench folder that is built with the project's objects using Google Benchmark." << std::endl;
     std::cout << "-VSCode_Files      Adds settings files for vscode to build and launch the program." << std::endl;
     std::cout << "-Resource_File     Adds a resource file to use while compiling. Used on the Windows OS." << std::endl;
     std::cout << "-Generate_Batch    Generates batch build files regardless of the OS." << std::endl;
     std::cout << "-Generate_Shell    Generates shell build files regardless of the OS." << std::endl;
+    std::cout << "-LTO               Uses link time optimization for the release build." << std::endl;
+    std::cout << "-ThinLTO           Uses ThinLTO with a cache for the release build. (Clang only. Other compilers use -LTO)" << std::endl;
+    std::cout << "-Linker name       Sets the linker to lld, mold, gold, or default. Found automatically on Linux." << std::endl;
+    std::cout << "-Cache name        Runs the compiler through ccache or sccache." << std::endl;
+    std::cout << "-Trace_Build       Writes a clang time trace for every object. Used by -report-build-times." << std::endl;
+    std::cout << "-PGO               Adds the Instrumented and PGO builds for profile guided optimization. (Clang and GCC)" << std::endl;
+    std::cout << "-Watch_Build       Runs ninja on the debug build after every change while using -watch." << std::endl;
+    std::cout << "-PCH header        Precompiles the header once per build type and uses it for every source file." << std::endl;
+    std::cout << "-Unity_Build N     Batches the source files into N generated unity files that are compiled instead." << std::endl;
 
     std::cout << std::endl;
     std::cout << "----------------------------" << std::endl;
@@ -89,6 +276,31 @@ void helpFunc()
     std::cout << "OTHER" << std::endl;
 }
 
+std::string getConfigName(int config)
+{
+    if(config == CONFIG_DEBUG)
+        return "Debug";
+    else if(config == CONFIG_INSTRUMENTED)
+        return "Instrumented";
+    else if(config == CONFIG_PGO)
+        return "PGO";
+    else if(config == CONFIG_RELWITHDEBINFO)
+        return "RelWithDebInfo";
+    else
+        return "Release";
+}
+
+std::vector<int> getConfigs()
+{
+    std::vector<int> configs = {CONFIG_DEBUG, CONFIG_RELEASE, CONFIG_RELWITHDEBINFO};
+    if(profileGuided)
+    {
+        configs.push_back(CONFIG_INSTRUMENTED);
+        configs.push_back(CONFIG_PGO);
+    }
+    return configs;
+}
+
 void createDir(std::string t)
 {
     //figure out if it has the slash at the back
@@ -111,14 +323,23 @@ bool createDirectories()
         createDir("build");
         createDir("res");
 
-        createDir("bin/Debug");
-        createDir("bin/Release");
+        for(int config : getConfigs())
+        {
+            std::string configName = getConfigName(config);
+            createDir("bin/" + configName);
+            createDir("build/" + configName);
+            createDir("bin/" + configName + "/obj");
 
-        createDir("build/Debug");
-        createDir("build/Release");
+            if(ltoType == LTO_THIN && compilerType == TYPE_CLANG && (config == CONFIG_RELEASE || config == CONFIG_PGO))
+            {
+                createDir("build/" + configName + "/thinlto");
+            }
+        }
 
-        createDir("bin/Debug/obj");
-        createDir("bin/Release/obj");
+        if(profileGuided)
+        {
+            createDir("bin/Instrumented/profiles");
+        }
 
         if(isStaticLibrary)
         {
@@ -140,6 +361,11 @@ bool createDirectories()
         {
             createDir(".vscode");
         }
+
+        if(includeBenchmarks)
+        {
+            createDir("bench");
+        }
     }
     else
     {
@@ -236,72 +462,384 @@ void createProjectResFiles()
     }
 }
 
-void createNinjaVarFile()
+std::string getArchName(int arch)
+{
+    if(arch == ARCH_NATIVE)
+        return "native";
+    else if(arch == ARCH_X86_64_V2)
+        return "x86-64-v2";
+    else if(arch == ARCH_X86_64_V3)
+        return "x86-64-v3";
+    else if(arch == ARCH_X86_64_V4)
+        return "x86-64-v4";
+    return "x86-64";
+}
+
+std::string getArchFlags(int arch)
 {
-    std::fstream file(startDir + "/build/Debug/vars.ninja", std::fstream::out | std::fstream::binary);
+    if(arch == ARCH_DEFAULT || arch == ARCH_MULTI)
+        return "";
     
-    if(file.is_open())
+    //msvc only has flags for the AVX levels
+    if(compilerType == TYPE_MSVC)
     {
-        if(includeWindowsStuff)
-        {
-            if(processorType == PROC_TYPE_32BIT)
-                file << "inc = -I ./include %WLIBPATH32%\n";
-            else
-                file << "inc = -I ./include %WLIBPATH64%\n";
-        }
-        else
-            file << "inc = -I ./include\n";
+        if(arch == ARCH_X86_64_V3)
+            return " /arch:AVX2";
+        else if(arch == ARCH_X86_64_V4)
+            return " /arch:AVX512";
+        return "";
+    }
+    return " -march=" + getArchName(arch);
+}
 
-        file << "objDir = ./bin/Debug/obj\n";
+std::string getArchOutputFile(int arch)
+{
+    //used when building for each level. ./bin/Release/name.exe becomes ./bin/Release/name_x86-64-v3.exe
+    std::string k = "./bin/Release/" + projectName + "_" + getArchName(arch);
+    if(generateBatch)
+        k += ".exe";
+    return k;
+}
 
-        if(!generateBatch)
-            file << "compiler = ";
+std::string getBenchOutputFile()
+{
+    std::string k = "./bin/Release/" + projectName + "_bench";
+    if(generateBatch)
+        k += ".exe";
+    return k;
+}
+
+std::string findMainSource(const std::vector<std::string>& sourceFiles)
+{
+    //the benchmarks have their own main so the file that defines the project's main is left out
+    std::regex mainRegex = std::regex("(^|[^\\w])int\\s+main\\s*\\(");
+    for(const std::string& source : sourceFiles)
+    {
+        std::fstream file(startDir + "/" + source, std::fstream::in | std::fstream::binary);
+        std::stringstream content;
+        content << file.rdbuf();
+        if(std::regex_search(content.str(), mainRegex))
+            return source;
+    }
+    return "";
+}
+
+std::string getLauncherSource()
+{
+    std::string k = "";
+    k += "// Generated by cppPS. Starts the release build made for the best instruction set this cpu supports.\n";
+    k += "#include <string>\n";
+    k += "#ifdef _WIN32\n";
+    k += "    #include <process.h>\n";
+    k += "#else\n";
+    k += "    #include <unistd.h>\n";
+    k += "#endif\n";
+    k += "\n";
+    k += "int main(int argc, char** argv)\n";
+    k += "{\n";
+    k += "    __builtin_cpu_init();\n";
+    k += "    std::string level = \"x86-64\";\n";
+    k += "    if(__builtin_cpu_supports(\"avx512f\") && __builtin_cpu_supports(\"avx512bw\") && __builtin_cpu_supports(\"avx512cd\") && __builtin_cpu_supports(\"avx512dq\") && __builtin_cpu_supports(\"avx512vl\"))\n";
+    k += "        level = \"x86-64-v4\";\n";
+    k += "    else if(__builtin_cpu_supports(\"avx2\") && __builtin_cpu_supports(\"bmi2\") && __builtin_cpu_supports(\"fma\"))\n";
+    k += "        level = \"x86-64-v3\";\n";
+    k += "    else if(__builtin_cpu_supports(\"sse4.2\") && __builtin_cpu_supports(\"popcnt\") && __builtin_cpu_supports(\"ssse3\"))\n";
+    k += "        level = \"x86-64-v2\";\n";
+    k += "\n";
+    k += "    std::string path = argv[0];\n";
+    k += "#ifdef _WIN32\n";
+    k += "    if(path.size() > 4 && path.substr(path.size()-4) == \".exe\")\n";
+    k += "        path = path.substr(0, path.size()-4);\n";
+    k += "    path += \"_\" + level + \".exe\";\n";
+    k += "    _execv(path.c_str(), argv);\n";
+    k += "#else\n";
+    k += "    char selfPath[4096];\n";
+    k += "    ssize_t length = readlink(\"/proc/self/exe\", selfPath, sizeof(selfPath)-1);\n";
+    k += "    if(length > 0)\n";
+    k += "        path = std::string(selfPath, length);\n";
+    k += "    path += \"_\" + level;\n";
+    k += "    execv(path.c_str(), argv);\n";
+    k += "#endif\n";
+    k += "    return 1;\n";
+    k += "}\n";
+    return k;
+}
+
+std::string getLTOFlags(int config)
+{
+    //only used by the optimized builds that are shipped
+    if(ltoType == LTO_NONE || (config != CONFIG_RELEASE && config != CONFIG_PGO))
+        return "";
+    
+    if(compilerType == TYPE_MSVC)
+        return " /GL";
+    else if(compilerType == TYPE_CLANG)
+        return (ltoType == LTO_THIN)? " -flto=thin" : " -flto";
+    else
+        return " -flto=auto";
+}
+
+std::string getProjectPath(std::string path)
+{
+    //the instrumented program can be run from any folder so the profiles need a full path
+    return fs::absolute(startDir + path).lexically_normal().generic_string();
+}
+
+std::string getPGOFlags(int config)
+{
+    //clang writes raw profiles into one folder that are merged by llvm-profdata.
+    //gcc names each .gcda in the folder after its object. The object folder is left out
+    //of the name so the PGO objects find the profiles of the instrumented ones, and
+    //sources added after training are built without a profile instead of failing.
+    std::string profileDir = getProjectPath("bin/Instrumented/profiles");
+    if(config == CONFIG_INSTRUMENTED)
+    {
+        if(compilerType == TYPE_CLANG)
+            return " -fprofile-generate=\"" + profileDir + "\"";
         else
-            file << "compiler = cmd /c ";
+            return " -fprofile-generate -fprofile-update=atomic -fprofile-dir=\"" + profileDir + "\" -fprofile-prefix-path=\"" + getProjectPath("bin/Instrumented/obj") + "\"";
+    }
+    else if(config == CONFIG_PGO)
+    {
+        if(compilerType == TYPE_CLANG)
+            return " -fprofile-use=./build/PGO/default.profdata";
+        else
+            return " -fprofile-use -fprofile-dir=\"" + profileDir + "\" -fprofile-prefix-path=\"" + getProjectPath("bin/PGO/obj") + "\" -Wno-missing-profile";
+    }
+    return "";
+}
 
-        file << (compilerName + "\n");
+bool isProgramOnPath(std::string name)
+{
+    const char* pathValue = std::getenv("PATH");
+    if(pathValue == nullptr)
+        return false;
+    
+    #ifdef LINUX
+        char separator = ':';
+    #else
+        char separator = ';';
+        name += ".exe";
+    #endif
+
+    std::stringstream paths(pathValue);
+    std::string dir;
+    while(std::getline(paths, dir, separator))
+    {
+        std::error_code err;
+        if(!dir.empty() && fs::exists(fs::path(dir) / name, err))
+            return true;
+    }
+    return false;
+}
 
-        if(compilerType!=TYPE_MSVC)
-        {
-            file << "CXXFLAGS = -std=c++17\n";
-            file << "OPTIONS = -c -g -Wno-unused-command-line-argument";
+int findLinker()
+{
+    //fastest first
+    if(isProgramOnPath("ld.mold") || isProgramOnPath("mold"))
+        return LINKER_MOLD;
+    else if(isProgramOnPath("ld.lld"))
+        return LINKER_LLD;
+    else if(isProgramOnPath("ld.gold"))
+        return LINKER_GOLD;
+    return LINKER_DEFAULT;
+}
 
-            if(processorType == PROC_TYPE_32BIT)
-                file << " -m32";
-            else if(processorType == PROC_TYPE_64BIT)
-                file << " -m64";
+std::string getLinkerFlags()
+{
+    //msvc uses its own linker
+    if(compilerType == TYPE_MSVC)
+        return "";
+    
+    if(linkerType == LINKER_LLD)
+        return " -fuse-ld=lld";
+    else if(linkerType == LINKER_MOLD)
+        return " -fuse-ld=mold";
+    else if(linkerType == LINKER_GOLD)
+        return " -fuse-ld=gold";
+    return "";
+}
+
+std::string getFastDebugFlags(int config, bool linking)
+{
+    //split and compressed debug info keeps most of the DWARF out of the link.
+    //The gdb index needs a linker other than the default bfd one.
+    if(!fastDebugOptions || compilerType == TYPE_MSVC)
+        return "";
+    if(config != CONFIG_DEBUG && config != CONFIG_RELWITHDEBINFO)
+        return "";
+    
+    if(!linking)
+        return " -gsplit-dwarf -gz";
+    else if(linkerType != LINKER_DEFAULT && linkerType != LINKER_AUTO)
+        return " -gz -Wl,--gdb-index";
+    else
+        return " -gz";
+}
+
+std::string getCompilerLauncher()
+{
+    if(compilerCacheType == CACHE_CCACHE)
+        return "ccache ";
+    else if(compilerCacheType == CACHE_SCCACHE)
+        return "sccache ";
+    return "";
+}
+
+std::string getCacheFlags()
+{
+    //the debug info has the folder the compiler ran in. Mapping it to . lets
+    //the same source hit the cache from any copy of the project.
+    if(compilerCacheType == CACHE_NONE || compilerType == TYPE_MSVC)
+        return "";
+    
+    if(generateBatch)
+        return " -fdebug-prefix-map=%CD%=.";
+    else
+        return " -fdebug-prefix-map=$$PWD=.";
+}
+
+std::string getArchiver()
+{
+    //gcc objects built with link time optimization need the gcc plugin to be archived
+    if(ltoType != LTO_NONE && compilerType != TYPE_CLANG && compilerType != TYPE_MSVC)
+        return "gcc-ar";
+    return "llvm-ar";
+}
+
+std::string getLinkFlags(int config)
+{
+    bool debug = (config == CONFIG_DEBUG);
+    //the flags used by the link rule. Windows environment variables
+    //are expanded by cmd for batch files and by the shell otherwise.
+    std::string pathVar32 = (generateBatch)? "%WLIBPATH32%" : "$$WLIBPATH32";
+    std::string pathVar64 = (generateBatch)? "%WLIBPATH64%" : "$$WLIBPATH64";
+    std::string valuesVar = (generateBatch)? "%WLIBVALUES%" : "$$WLIBVALUES";
+    std::string k = "";
 
+    if(compilerType != TYPE_MSVC)
+    {
+        if(debug)
+        {
+            k += " -g";
             if(extraDebugOptions)
-                file << " -fsanitize=address\n";
-            else
-                file << "\n";
+                k += " -fsanitize=address";
+        }
+        else if(config == CONFIG_RELWITHDEBINFO)
+        {
+            k += " -O2 -g";
+            k += getArchFlags(archType);
         }
         else
         {
-            file << "CXXFLAGS = /std:c++17\n";
-            file << "OPTIONS = /c ";
-
-            if(processorType == PROC_TYPE_32BIT)
-                file << " /MACHINE:x86";
-            else if(processorType == PROC_TYPE_64BIT)
-                file << " /MACHINE:x64";
+            k += " -O3";
+            k += getArchFlags(archType);
+            k += getLTOFlags(config);
+            k += getPGOFlags(config);
             
-            if(extraDebugOptions)
-                file << " /fsanitize=address\n";
-            else
-                file << "\n";
+            //thinlto keeps its work between links so only changed objects are optimized again
+            if(ltoType == LTO_THIN && compilerType == TYPE_CLANG && getLTOFlags(config) != "")
+            {
+                if(linkerType == LINKER_LLD)
+                    k += " -Wl,--thinlto-cache-dir=./build/" + getConfigName(config) + "/thinlto";
+                else
+                    k += " -Wl,--plugin-opt=cache-dir=./build/" + getConfigName(config) + "/thinlto";
+            }
         }
+
+        k += getFastDebugFlags(config, true);
+        k += getLinkerFlags();
+
+        if(processorType == PROC_TYPE_32BIT)
+            k += " -m32";
+        else if(processorType == PROC_TYPE_64BIT)
+            k += " -m64";
+
+        if(isGuiApplication)
+            k += " -Wl,-subsystem:windows -Wl,-entrypoint:mainCRTStartup";
+    }
+    else
+    {
+        if(debug && fastDebugOptions)
+            k += " /DEBUG:FASTLINK";
+        else
+            k += " /DEBUG";
+        if(debug && extraDebugOptions)
+            k += " /fsanitize=address";
         
-        file << "compilerFlags = $OPTIONS $CXXFLAGS\n";
+        if(!debug)
+            k += " /O2";
+
+        if(processorType == PROC_TYPE_32BIT)
+            k += " /machine:x86";
+        else if(processorType == PROC_TYPE_64BIT)
+            k += " /machine:x64";
+
+        if(isGuiApplication)
+            k += " /subsystem:windows /entrypoint:mainCRTStartup";
     }
 
-    file.close();
+    if(includeWindowsStuff)
+    {
+        if(processorType == PROC_TYPE_32BIT)
+            k += " " + pathVar32 + " " + valuesVar;
+        else
+            k += " " + pathVar64 + " " + valuesVar;
+    }
 
+    //the resource file is only compiled by the batch files using llvm-rc or rc
+    if(includeResourceFile && generateBatch && (compilerType == TYPE_CLANG || compilerType == TYPE_MSVC))
+        k += " res/" + projectName + ".res";
 
-    file = std::fstream(startDir + "/build/Release/vars.ninja", std::fstream::out | std::fstream::binary);
+    if(k.size() > 0)
+        k = k.substr(1);
+
+    return k;
+}
+
+std::string getOutputFile(int config)
+{
+    std::string k = "./bin/" + getConfigName(config) + "/";
+    k += projectName;
+    if(generateBatch)
+        k += ".exe";
+    return k;
+}
+
+std::string getCompilerTypeName()
+{
+    if(compilerType == TYPE_MSVC)
+        return "msvc";
+    else if(compilerType == TYPE_GCC)
+        return "gcc";
+    return "clang";
+}
+
+std::string getModuleScanner()
+{
+    //the compiler is used without the cache launcher since the scan is not cached
+    if(compilerType != TYPE_CLANG)
+        return compilerName;
     
-    if(file.is_open())
+    //uses the clang-scan-deps next to the compiler so clang++-17 uses clang-scan-deps-17
+    std::string scanner = compilerName;
+    size_t nameIndex = scanner.find_last_of("/\\");
+    nameIndex = (nameIndex == SIZE_MAX)? 0 : nameIndex+1;
+    size_t index = scanner.find("clang", nameIndex);
+    if(index != SIZE_MAX)
+        scanner.replace(index, (scanner.compare(index, 7, "clang++") == 0)? 7 : 5, "clang-scan-deps");
+    else
+        scanner = "clang-scan-deps";
+    
+    return scanner + " -format=p1689 -- " + compilerName;
+}
+
+void writeNinjaVarFile(std::ostream& file, int config)
+{
+    if(file.good())
     {
+        bool debug = (config == CONFIG_DEBUG);
+
         if(includeWindowsStuff)
         {
             if(processorType == PROC_TYPE_32BIT)
@@ -311,874 +849,3238 @@ void createNinjaVarFile()
         }
         else
             file << "inc = -I ./include\n";
-            
-        file << "objDir = ./bin/Release/obj\n";
+
+        //no leading ./ since gcc names the .gcda of each object after the full path it builds
+        //from the current folder and -fprofile-prefix-path has to match the start of it
+        file << "objDir = bin/" << getConfigName(config) << "/obj\n";
 
         if(!generateBatch)
             file << "compiler = ";
         else
             file << "compiler = cmd /c ";
 
-        file << (compilerName + "\n");
+        file << (getCompilerLauncher() + compilerName + "\n");
 
         if(compilerType!=TYPE_MSVC)
         {
-            file << "CXXFLAGS = -std=c++17 -O3\n";
-            file << "OPTIONS = -c -Wno-unused-command-line-argument\n";
+            std::string optimizeFlags = "";
+            if(config == CONFIG_RELWITHDEBINFO)
+                optimizeFlags = " -O2" + getArchFlags(archType);
+            else if(!debug)
+                optimizeFlags = " -O3" + getArchFlags(archType) + getLTOFlags(config) + getPGOFlags(config);
+            
+            if(useModules && compilerType == TYPE_GCC)
+                file << "CXXFLAGS = -std=c++20 -fmodules-ts" << optimizeFlags << "\n";
+            else if(useModules)
+                file << "CXXFLAGS = -std=c++20" << optimizeFlags << "\n";
+            else
+                file << "CXXFLAGS = -std=c++17" << optimizeFlags << "\n";
+            file << "CFLAGS = -std=c11" << optimizeFlags << "\n";
+            
+            if(debug || config == CONFIG_RELWITHDEBINFO)
+                file << "OPTIONS = -c -g -Wno-unused-command-line-argument";
+            else
+                file << "OPTIONS = -c -Wno-unused-command-line-argument";
+
+            file << getFastDebugFlags(config, false);
 
             if(processorType == PROC_TYPE_32BIT)
                 file << " -m32";
             else if(processorType == PROC_TYPE_64BIT)
                 file << " -m64";
+
+            file << getCacheFlags();
+
+            if(debug && extraDebugOptions)
+                file << " -fsanitize=address\n";
+            else
+                file << "\n";
         }
         else
         {
-            file << "CXXFLAGS = /std:c++17 /O2\n";
-            file << "OPTIONS = /c\n";
+            std::string optimizeFlags = "";
+            if(config == CONFIG_RELWITHDEBINFO)
+            {
+                //Z7 keeps the debug info in each object so parallel builds do not share a pdb
+                optimizeFlags = " /O2 /Z7" + getArchFlags(archType);
+            }
+            else if(!debug)
+            {
+                optimizeFlags = " /O2" + getArchFlags(archType) + getLTOFlags(config);
+            }
+
+            if(useModules)
+                file << "CXXFLAGS = /std:c++20" << optimizeFlags << "\n";
+            else
+                file << "CXXFLAGS = /std:c++17" << optimizeFlags << "\n";
+            file << "CFLAGS = /std:c11" << optimizeFlags << "\n";
+            if(debug)
+                file << "OPTIONS = /c ";
+            else
+                file << "OPTIONS = /c";
 
             if(processorType == PROC_TYPE_32BIT)
                 file << " /MACHINE:x86";
             else if(processorType == PROC_TYPE_64BIT)
                 file << " /MACHINE:x64";
+            
+            if(debug && extraDebugOptions)
+                file << " /fsanitize=address\n";
+            else
+                file << "\n";
         }
-
+        
         file << "compilerFlags = $OPTIONS $CXXFLAGS\n";
+        file << "cFlags = $OPTIONS $CFLAGS\n";
+        if(useModules)
+            file << "moduleScanner = " << getModuleScanner() << "\n";
+        file << "linkFlags = " << getLinkFlags(config) << "\n";
+
+        //options after /LINK go straight to the msvc linker
+        if(compilerType == TYPE_MSVC && getLTOFlags(config) != "")
+            file << "linkerFlags = /LTCG\n";
+        file << "outputFile = " << getOutputFile(config) << "\n";
+    }
+}
+
+int writeFileIfChanged(std::string filename, const std::string& content)
+{
+    //leaves the file alone if it already has the same content so
+    //its modified time does not change and ninja does not rebuild it.
+    std::fstream inputFile(filename, std::fstream::in | std::fstream::binary);
+    if(inputFile.is_open())
+    {
+        std::stringstream oldContent;
+        oldContent << inputFile.rdbuf();
+        inputFile.close();
+
+        if(oldContent.str() == content)
+            return WRITE_UNCHANGED;
     }
 
+    //written to a temporary file first and renamed over the old one so
+    //ninja never sees a partially written file.
+    std::string tempName = filename + ".tmp";
+    std::fstream file(tempName, std::fstream::out | std::fstream::binary);
+    if(!file.is_open())
+    {
+        std::cout << "ERROR: Could not write " << filename << std::endl;
+        return WRITE_FAILED;
+    }
+
+    file << content;
     file.close();
 
+    std::error_code err;
+    fs::rename(tempName, filename, err);
+    if(err)
+    {
+        std::cout << "ERROR: Could not replace " << filename << ". " << err.message() << std::endl;
+        fs::remove(tempName, err);
+        return WRITE_FAILED;
+    }
+    return WRITE_CHANGED;
+}
+
+void createNinjaVarFile()
+{
+    //-u writes these every time so they are only replaced when something changed
+    for(int config : getConfigs())
+    {
+        std::stringstream file;
+        writeNinjaVarFile(file, config);
+        writeFileIfChanged(startDir + "/build/" + getConfigName(config) + "/vars.ninja", file.str());
+    }
+}
+
+bool isModuleUnit(const std::string& fileName)
+{
+    std::string extension = fs::path(fileName).extension().string();
+    return extension == ".cppm" || extension == ".ixx";
+}
+
+bool isSourceFile(const std::string& fileName)
+{
+    std::string extension = fs::path(fileName).extension().string();
+    if(useModules && isModuleUnit(fileName))
+        return true;
+    return extension == ".cpp" || extension == ".cc" || extension == ".cxx" || extension == ".c";
+}
+
+bool isCSource(const std::string& fileName)
+{
+    return fs::path(fileName).extension() == ".c";
 }
 
-void addSubDirStuff(std::fstream& file, std::string srcDir, std::string dirName)
+bool globMatch(const char* pattern, const char* text)
 {
-    for(fs::directory_entry f : fs::directory_iterator(srcDir))
+    //* and ? do not match across folders. ** does.
+    while(*pattern != 0)
     {
-        if(fs::is_regular_file(f.path()))
+        if(pattern[0] == '*' && pattern[1] == '*')
         {
-            std::string nameString = f.path().stem().string();
-            std::string extension = f.path().extension().string();
-            file << "build $objDir/";
-            file << nameString;
-            if(compilerType != TYPE_MSVC)
-                file << ".o: buildToObject ";
-            else
-                file << ".o: buildToObject ";
-            file << dirName;
-            file << nameString;
-            file << extension;
-            file << "\n";
+            pattern += 2;
+            //"**/" can also match no folders at all
+            if(*pattern == '/' && globMatch(pattern+1, text))
+                return true;
+            
+            for(const char* t = text; ; t++)
+            {
+                if(globMatch(pattern, t))
+                    return true;
+                if(*t == 0)
+                    return false;
+            }
         }
-        else if(fs::is_directory(f.path()))
+        else if(*pattern == '*')
         {
-            size_t l1,l2,l3;
-            l1 = f.path().string().find_last_of('/');
-            l2 = f.path().string().find_last_of('\\');
-            if(l1==SIZE_MAX)
+            pattern++;
+            for(const char* t = text; ; t++)
             {
-                if(l2==SIZE_MAX)
-                    l3 = 0;
-                else
-                    l3 = l2;
+                if(globMatch(pattern, t))
+                    return true;
+                if(*t == 0 || *t == '/')
+                    return false;
             }
-            else
-            {
-                if(l2==SIZE_MAX)
-                    l3 = l1;
-                else
-                    l3 = (l1 < l2)? l2 : l1;
-            }
-            
-            std::string folderName = f.path().string().substr(l3+1);
-            std::string newDirName = dirName+folderName+'/';
-            addSubDirStuff(file, f.path().string(), newDirName);
         }
-    }
-}
-
-void createNinjaFile()
-{
-    std::fstream file(startDir + "/build/Debug/build.ninja", std::fstream::out | std::fstream::binary);
-    
-    if(file.is_open())
-    {
-        file << "# Processor Type set to ";
-        if(processorType == PROC_TYPE_32BIT)
-            file << "32 bit\n";
-        else if(processorType == PROC_TYPE_64BIT)
-            file << "64 bit\n";
-        else
-            file << "UNKNOWN TYPE\n";
-        
-        file << "# Include variables for this build\n";
-        file << "include ./build/Debug/vars.ninja\n\n";
-
-        file << "## for getting object files\n";
-        file << "## This also gets dependencies\n";
-
-        if(compilerType != TYPE_MSVC)
+        else if(*text == 0 || (*text != *pattern && (*pattern != '?' || *text == '/')))
         {
-            file << "rule buildToObject\n";
-            file << "   deps = gcc\n";
-            file << "   depfile = $out.d\n";
-            file << "   command = $compiler $compilerFlags $inc $in -o $out -MMD -MF $out.d\n";
-            file << "\n";
+            return false;
         }
         else
         {
-            file << "rule buildToObject\n";
-            file << "   deps = msvc\n";
-            file << "   command = $compiler $compilerFlags $inc $in /showIncludes /Fo$out\n";
-            file << "\n";
+            pattern++;
+            text++;
         }
-
-        //proceed to build all objects using the same syntax as this
-        //build $objDir/Person.o: buildToObject src/Person.cpp
-
-        file << "## build all of the objects and the executable\n";
-        std::string srcDir = startDir+"/src";
-
-        addSubDirStuff(file, srcDir, "src/");
     }
+    return *text == 0;
+}
 
-    file.close();
-
-    file = std::fstream(startDir + "/build/Release/build.ninja", std::fstream::out | std::fstream::binary);
-    
-    if(file.is_open())
+std::vector<std::string> readPatternFile(std::string filename)
+{
+    //one glob pattern per line. Lines starting with # are comments.
+    std::vector<std::string> patterns;
+    std::fstream file(startDir + "/" + filename, std::fstream::in | std::fstream::binary);
+    std::string line;
+    while(std::getline(file, line))
     {
-        file << "# Processor Type set to ";
-        if(processorType == PROC_TYPE_32BIT)
-            file << "32 bit\n";
-        else if(processorType == PROC_TYPE_64BIT)
-            file << "64 bit\n";
-        else
-            file << "UNKNOWN TYPE\n";
+        while(!line.empty() && std::isspace((unsigned char)line.back()))
+            line.pop_back();
         
-        file << "# Include variables for this build\n";
-        file << "include ./build/Release/vars.ninja\n\n";
+        if(!line.empty() && line[0] != '#')
+            patterns.push_back(line);
+    }
+    return patterns;
+}
 
-        file << "## for getting object files\n";
-        file << "## This also gets dependencies\n";
+bool matchesPatterns(const std::string& path, const std::string& fileName, bool directory, const std::vector<std::string>& patterns)
+{
+    //Like .gitignore, a pattern without a / matches the name in any folder. Otherwise it
+    //matches the path from the project folder. A pattern ending with / only matches folders.
+    for(std::string pattern : patterns)
+    {
+        if(pattern.back() == '/')
+        {
+            if(!directory)
+                continue;
+            pattern.pop_back();
+        }
 
-        if(compilerType != TYPE_MSVC)
+        if(pattern.find('/') == SIZE_MAX)
         {
-            file << "rule buildToObject\n";
-            file << "   deps = gcc\n";
-            file << "   depfile = $out.d\n";
-            file << "   command = $compiler $compilerFlags $inc $in -o $out -MMD -MF $out.d\n";
-            file << "\n";
+            if(globMatch(pattern.c_str(), fileName.c_str()))
+                return true;
         }
         else
         {
-            file << "rule buildToObject\n";
-            file << "   deps = msvc\n";
-            file << "   command = $compiler $compilerFlags $inc $in /showIncludes /Fo$out\n";
-            file << "\n";
+            if(pattern[0] == '/')
+                pattern = pattern.substr(1);
+            if(globMatch(pattern.c_str(), path.c_str()))
+                return true;
         }
-        //proceed to build all objects using the same syntax as this
-        //build $objDir/Person.o: buildToObject src/Person.cpp
-
-        file << "## build all of the objects and the executable\n";
-        std::string srcDir = startDir+"/src";
-
-        addSubDirStuff(file, srcDir, "src/");
     }
-
-    file.close();
-
+    return false;
 }
 
-void writeCompileShell(std::fstream& file, bool debug)
+void scanDir(const std::string& srcDir, const std::string& dirName, const std::vector<std::string>& ignorePatterns, std::vector<std::string>& sourceFiles, std::vector<std::pair<std::string, std::string>>& subDirs)
 {
-    if(file.is_open())
+    std::error_code err;
+    for(const fs::directory_entry& f : fs::directory_iterator(srcDir, err))
     {
-        file << "#!/bin/bash\n";
-        
-        if(debug)
+        //the file type is cached when the folder is read so this does not stat every file
+        std::string fileName = f.path().filename().string();
+        if(f.is_regular_file(err))
         {
-            file << "ninja -f ./build/Debug/build.ninja -v\n";
+            if(isSourceFile(fileName) && !matchesPatterns(dirName + fileName, fileName, false, ignorePatterns))
+                sourceFiles.push_back(dirName + fileName);
         }
-        else
+        else if(f.is_directory(err))
         {
-            file << "ninja -f ./build/Release/build.ninja -v\n";
+            //ignored folders are never read
+            if(!matchesPatterns(dirName + fileName, fileName, true, ignorePatterns))
+                subDirs.push_back({f.path().string(), dirName + fileName + '/'});
         }
+    }
+}
 
-        if(compilerType != TYPE_MSVC)
-        {
-            file << "debugOptions=\"";
+size_t addSubDirStuff(std::vector<std::string>& sourceFiles, std::string srcDir, std::string dirName, std::map<std::string, DirState>* index = nullptr)
+{
+    //Folders are read one level at a time and each level is split across threads.
+    //Every thread keeps its own lists so nothing has to be locked.
+    //With an index a folder whose modified time did not change is taken from it instead of being read.
+    //Returns how many folders were actually read.
+    std::vector<std::pair<std::string, std::string>> level = {{srcDir, dirName}};
+    std::vector<std::string> ignorePatterns = readPatternFile(".cppsignore");
+    size_t threadCount = max(std::thread::hardware_concurrency(), 1u);
+    size_t foldersRead = 0;
+    std::map<std::string, DirState> newIndex;
+
+    //a folder changed this recently could change again within the same clock tick so it is read again next time
+    fs::file_time_type recentTime = fs::file_time_type::clock::now() - std::chrono::seconds(2);
+
+    while(!level.empty())
+    {
+        size_t count = (level.size() < threadCount)? level.size() : threadCount;
+        std::vector<std::vector<std::string>> files(count);
+        std::vector<std::vector<std::pair<std::string, std::string>>> subDirs(count);
+        std::vector<std::vector<std::pair<std::string, DirState>>> states(count);
+        std::vector<size_t> readCounts(count, 0);
 
-            if(debug)
+        auto scanPart = [&](size_t part)
+        {
+            for(size_t i=part; i<level.size(); i+=count)
             {
-                file << "-g";
-                if(extraDebugOptions)
+                const std::string& path = level[i].first;
+                const std::string& name = level[i].second;
+                if(index == nullptr)
                 {
-                    file << " -fsantize=address";
+                    scanDir(path, name, ignorePatterns, files[part], subDirs[part]);
+                    readCounts[part]++;
+                    continue;
                 }
-            }
-            file << "\"\n";
 
-            file << "linkOptions=\"";
-            if(includeWindowsStuff)
-            {
-                if(processorType != PROC_TYPE_32BIT)
-                    file << "$WLIBPATH64 WLIBVALUES";
-                else
-                    file << "$WLIBPATH86 WLIBVALUES";
-            }
-            file << "\"\n";
+                std::error_code err;
+                fs::file_time_type writeTime = fs::last_write_time(path, err);
+                DirState state;
+                state.writeTime = (err)? 0 : (long long)writeTime.time_since_epoch().count();
 
-            file << "extraOptions=\"";
-            std::string spaceBuffer = "";
-            if(!debug)
-            {
-                file << "-O3";
-                spaceBuffer = " ";
-            }
-            if(processorType == PROC_TYPE_64BIT)
-            {
-                file << spaceBuffer;
-                file << "-m64";
-                spaceBuffer = " ";
-            }
-            else if(processorType == PROC_TYPE_32BIT)
-            {
-                file << spaceBuffer;
-                file << "-m32";
-                spaceBuffer = " ";
+                auto it = index->find(name);
+                if(state.writeTime != 0 && it != index->end() && it->second.writeTime == state.writeTime)
+                {
+                    state = it->second;
+                    for(const std::string& file : state.files)
+                        files[part].push_back(name + file);
+                    for(const std::string& sub : state.subDirs)
+                        subDirs[part].push_back({path + "/" + sub, name + sub + '/'});
+                }
+                else
+                {
+                    size_t firstFile = files[part].size();
+                    size_t firstDir = subDirs[part].size();
+                    scanDir(path, name, ignorePatterns, files[part], subDirs[part]);
+                    readCounts[part]++;
+
+                    for(size_t j=firstFile; j<files[part].size(); j++)
+                        state.files.push_back(files[part][j].substr(name.size()));
+                    for(size_t j=firstDir; j<subDirs[part].size(); j++)
+                    {
+                        const std::string& subName = subDirs[part][j].second;
+                        state.subDirs.push_back(subName.substr(name.size(), subName.size() - name.size() - 1));
+                    }
+                    if(!err && writeTime > recentTime)
+                        state.writeTime = 0;
+                }
+                states[part].push_back({name, std::move(state)});
             }
-            file << "\"\n";
+        };
 
-            if(debug)
-            {
-                file << "projectCommand=\"./bin/Debug/obj/*.o -o ./bin/Debug/";
-            }
-            else
-            {
-                file << "projectCommand=\"./bin/Release/obj/*.o -o ./bin/Release/";
-            }
+        std::vector<std::thread> threads;
+        for(size_t part=1; part<count; part++)
+            threads.emplace_back(scanPart, part);
+        scanPart(0);
+        for(std::thread& t : threads)
+            t.join();
 
-            file << projectName;
-            file << "\"\n";
-        }
-        else
+        std::vector<std::pair<std::string, std::string>> nextLevel;
+        for(size_t part=0; part<count; part++)
         {
-            file << "debugOptions=\"/DEBUG";
+            sourceFiles.insert(sourceFiles.end(), std::make_move_iterator(files[part].begin()), std::make_move_iterator(files[part].end()));
+            nextLevel.insert(nextLevel.end(), std::make_move_iterator(subDirs[part].begin()), std::make_move_iterator(subDirs[part].end()));
+            for(std::pair<std::string, DirState>& state : states[part])
+                newIndex[state.first] = std::move(state.second);
+            foldersRead += readCounts[part];
+        }
+        level = std::move(nextLevel);
+    }
 
-            if(extraDebugOptions)
-            {
-                file << " /fsantize=address";
-            }
-            file << "\"\n";
+    //folders that were removed are dropped from the index
+    if(index != nullptr)
+        *index = std::move(newIndex);
+    return foldersRead;
+}
 
-            file << "linkOptions=\"";
-            if(includeWindowsStuff)
-            {
-                if(processorType != PROC_TYPE_32BIT)
-                    file << "$WLIBPATH64 $WLIBVALUES";
-                else
-                    file << "$WLIBPATH86 $WLIBVALUES";
-            }
-            file << "\"\n";
+uint32_t getStableHash(const std::string& s)
+{
+    //FNV-1a. std::hash is not required to give the same value between runs.
+    uint32_t hash = 2166136261u;
+    for(char c : s)
+    {
+        hash ^= (unsigned char)c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
 
-            file << "extraOptions=\"";
-            std::string spaceBuffer = "";
-            if(!debug)
-            {
-                file << "/O2";
-                spaceBuffer = " ";
-            }
-            if(processorType == PROC_TYPE_32BIT)
-            {
-                file << spaceBuffer;
-                file << "/machine:x86";
-                spaceBuffer = " ";
-            }
-            else if(processorType == PROC_TYPE_64BIT)
-            {
-                file << spaceBuffer;
-                file << "/machine:x64";
-                spaceBuffer = " ";
-            }
+std::string getSourceFilter()
+{
+    //changing what counts as a source means every folder has to be read again
+    std::string filter = (useModules)? "modules" : "";
+    for(const std::string& pattern : readPatternFile(".cppsignore"))
+        filter += "\n" + pattern;
+    return std::to_string(getStableHash(filter));
+}
 
-            if(isGuiApplication)
-            {
-                file << spaceBuffer;
-                file << "/subsystem:windows /entrypoint:mainCRTStartup";
-            }
-            file << "\"\n";
+void writeStateFile()
+{
+    //every option of the project and the index of src so -u can build the same project
+    //without the options being given again and without reading every folder.
+    std::stringstream file;
+    file << "# Written by cppPS. Used by -u to keep the options of the project." << std::endl;
+    file << "projectName = " << projectName << std::endl;
+    file << "compilerName = " << compilerName << std::endl;
+    file << "compilerType = " << (int)compilerType << std::endl;
+    file << "includeWindowsStuff = " << includeWindowsStuff << std::endl;
+    file << "includeResourceFile = " << includeResourceFile << std::endl;
+    file << "isStaticLibrary = " << isStaticLibrary << std::endl;
+    file << "isDynamicLibrary = " << isDynamicLibrary << std::endl;
+    file << "extraDebugOptions = " << extraDebugOptions << std::endl;
+    file << "fastDebugOptions = " << fastDebugOptions << std::endl;
+    file << "includeBenchmarks = " << includeBenchmarks << std::endl;
+    file << "vscodeOptions = " << vscodeOptions << std::endl;
+    file << "isGuiApplication = " << isGuiApplication << std::endl;
+    file << "unityBuildCount = " << unityBuildCount << std::endl;
+    file << "pchHeader = " << pchHeader << std::endl;
+    file << "processorType = " << processorType << std::endl;
+    file << "archType = " << archType << std::endl;
+    file << "ltoType = " << ltoType << std::endl;
+    file << "linkerType = " << ((linkerFound)? LINKER_AUTO : linkerType) << std::endl;
+    file << "profileGuided = " << profileGuided << std::endl;
+    file << "compilerCacheType = " << compilerCacheType << std::endl;
+    file << "generateBatch = " << generateBatch << std::endl;
+    file << "traceBuild = " << traceBuild << std::endl;
+    file << "linkJobs = " << linkJobs << std::endl;
+    file << "heavyJobs = " << heavyJobs << std::endl;
+    file << "useModules = " << useModules << std::endl;
+    file << "sourceFilter = " << getSourceFilter() << std::endl;
+
+    //each folder is followed by its sources and sub folders
+    for(const std::pair<const std::string, DirState>& dir : dirIndex)
+    {
+        file << "dir " << dir.second.writeTime << " " << dir.first << std::endl;
+        for(const std::string& name : dir.second.files)
+            file << "file " << name << std::endl;
+        for(const std::string& name : dir.second.subDirs)
+            file << "sub " << name << std::endl;
+    }
 
-            if(debug)
-            {
-                file << "projectCommand=\"/LINK ./bin/Debug/obj/*.o /OUT:./bin/Debug/";
-            }
-            else
-            {
-                file << "projectCommand=\"/LINK ./bin/Release/obj/*.o /OUT:./bin/Release/";
-            }
+    std::error_code err;
+    fs::create_directories(startDir + "/.cppps", err);
+    writeFileIfChanged(startDir + "/.cppps/state", file.str());
+}
 
-            file << projectName;
-            file << "\"\n";
-        }
-        
-        file << compilerName;
-        file << " $debugOptions $linkOptions $extraOptions $projectCommand";
+bool isOptionGiven(const std::vector<std::string>& names)
+{
+    for(const std::string& name : names)
+    {
+        if(givenOptions.count(name) > 0)
+            return true;
     }
+    return false;
 }
 
-void createShellFile()
+void readStateFlag(std::map<std::string, std::string>& options, std::string name, bool& flag, const std::vector<std::string>& optionNames)
 {
-    std::fstream file;
-    std::string k;
-
-    //DEBUG
-    file = std::fstream(startDir + "build/Debug/build.sh", std::fstream::out | std::fstream::binary);
-    writeCompileShell(file, true);
-    file.close();
-
-    //Note that this is required in linux to create a executable shell file.
-    system("chmod 755 build/Debug/build.sh");
+    if(!isOptionGiven(optionNames) && options.count(name) > 0)
+        flag = options[name] == "1";
+}
 
-    //RELEASE
-    file = std::fstream(startDir + "build/Release/build.sh", std::fstream::out | std::fstream::binary);
-    writeCompileShell(file, false);
-    file.close();
-    
-    //Note that this is required in linux to create a executable shell file.
-    system("chmod 755 build/Release/build.sh");
+void readStateNumber(std::map<std::string, std::string>& options, std::string name, int& value, const std::vector<std::string>& optionNames)
+{
+    if(!isOptionGiven(optionNames) && options.count(name) > 0)
+        value = std::atoi(options[name].c_str());
 }
 
-void writeCompileBatch(std::fstream& file, bool debug)
+bool readStateFile(bool useOptions)
 {
-    if(file.is_open())
+    //the folder index is always used. The options are skipped with -Reset_Options
+    //so only the ones given this time are used.
+    std::fstream file(startDir + "/.cppps/state", std::fstream::in | std::fstream::binary);
+    if(!file.is_open())
+        return false;
+
+    std::map<std::string, std::string> options;
+    DirState* currentDir = nullptr;
+    std::string line;
+    while(std::getline(file, line))
     {
-        file << "@echo OFF\n";
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if(line.empty() || line[0] == '#')
+            continue;
 
-        if(includeResourceFile)
+        if(line.rfind("dir ", 0) == 0)
         {
-            if(compilerType == TYPE_MSVC)
-                file << "rc res/";
-            else if(compilerType == TYPE_CLANG)
-                file << "llvm-rc res/";
-            else
-            {
-                std::cout << "ERROR: Can't compile resource file without llvm-rc(CLANG) or rc(MSVC)" << std::endl;
-                std::cout << "Resource file being skipped." << std::endl;
-                includeResourceFile = false;
-            }
-
-            if(includeResourceFile)
+            size_t index = line.find(' ', 4);
+            if(index == SIZE_MAX)
             {
-                file << "llvm-rc res/";
-                file << projectName;
-                file << ".rc\n";
+                currentDir = nullptr;
+                continue;
             }
+            currentDir = &dirIndex[line.substr(index+1)];
+            currentDir->writeTime = std::atoll(line.substr(4, index-4).c_str());
         }
-
-        if(debug)
+        else if(line.rfind("file ", 0) == 0)
         {
-            file << "ninja -f ./build/Debug/build.ninja -v\n";
+            if(currentDir != nullptr)
+                currentDir->files.push_back(line.substr(5));
+        }
+        else if(line.rfind("sub ", 0) == 0)
+        {
+            if(currentDir != nullptr)
+                currentDir->subDirs.push_back(line.substr(4));
         }
         else
         {
-            file << "ninja -f ./build/Release/build.ninja -v\n";
+            size_t index = line.find(" = ");
+            if(index != SIZE_MAX)
+                options[line.substr(0, index)] = line.substr(index+3);
         }
+    }
+    file.close();
+    dirIndexFilter = options["sourceFilter"];
+
+    //the name is not an option so it is kept either way
+    if(!isOptionGiven({"-n"}))
+        projectName = options["projectName"];
+    if(!useOptions)
+        return true;
+
+    //-ct only sets the type so the saved compiler is still used with it
+    if(!isOptionGiven({"-c"}) && options.count("compilerName") > 0)
+        compilerName = options["compilerName"];
+    if(!isOptionGiven({"-c", "-ct"}) && options.count("compilerType") > 0)
+        compilerType = (char)std::atoi(options["compilerType"].c_str());
+
+    readStateFlag(options, "includeWindowsStuff", includeWindowsStuff, {"-Include_Windows"});
+    readStateFlag(options, "includeResourceFile", includeResourceFile, {"-Resource_File"});
+    readStateFlag(options, "isStaticLibrary", isStaticLibrary, {"-Static_Library"});
+    readStateFlag(options, "isDynamicLibrary", isDynamicLibrary, {"-Dynamic_Library"});
+    readStateFlag(options, "extraDebugOptions", extraDebugOptions, {"-Ext_Debug_Flags"});
+    readStateFlag(options, "fastDebugOptions", fastDebugOptions, {"-Fast_Debug"});
+    readStateFlag(options, "includeBenchmarks", includeBenchmarks, {"-Benchmarks"});
+    readStateFlag(options, "vscodeOptions", vscodeOptions, {"-VSCode_Files"});
+    readStateFlag(options, "isGuiApplication", isGuiApplication, {"-Exclude_Console"});
+    readStateFlag(options, "profileGuided", profileGuided, {"-PGO"});
+    readStateFlag(options, "traceBuild", traceBuild, {"-Trace_Build"});
+    readStateFlag(options, "useModules", useModules, {"-Modules"});
+    readStateFlag(options, "generateBatch", generateBatch, {"-Generate_Shell", "-Generate_Batch"});
+
+    readStateNumber(options, "unityBuildCount", unityBuildCount, {"-Unity_Build"});
+    readStateNumber(options, "processorType", processorType, {"-32BIT", "-64BIT", "-GENERAL_PROCESSOR"});
+    readStateNumber(options, "archType", archType, {"-ARCH"});
+    readStateNumber(options, "ltoType", ltoType, {"-LTO", "-ThinLTO"});
+    readStateNumber(options, "linkerType", linkerType, {"-Linker"});
+    readStateNumber(options, "compilerCacheType", compilerCacheType, {"-Cache"});
+    readStateNumber(options, "linkJobs", linkJobs, {"-Link_Jobs"});
+    readStateNumber(options, "heavyJobs", heavyJobs, {"-Heavy_Jobs"});
+
+    if(!isOptionGiven({"-PCH"}))
+        pchHeader = options["pchHeader"];
+    return true;
+}
 
-        if(compilerType != TYPE_MSVC)
-        {
-            file << "set debugOptions=";
+std::vector<std::string> createUnityFiles(const std::vector<std::string>& sourceFiles, std::string batchName)
+{
+    //a source is placed into a batch by a hash of its path so adding or removing
+    //a file only changes the batch it belongs to.
+    std::vector<std::string> batchContents = std::vector<std::string>(unityBuildCount);
+    std::vector<std::string> unityFiles;
 
-            if(debug)
-            {
-                file << "-g";
-                if(extraDebugOptions)
-                {
-                    file << " -fsantize=address";
-                }
-            }
-            file << "\n";
+    for(const std::string& source : sourceFiles)
+    {
+        int batch = getStableHash(source) % unityBuildCount;
+        batchContents[batch] += "#include \"../../" + source + "\"\n";
+    }
 
-            file << "set linkOptions=";
-            if(includeWindowsStuff)
-            {
-                if(processorType != PROC_TYPE_32BIT)
-                    file << "%WLIBPATH64% %WLIBVALUES%";
-                else
-                    file << "%WLIBPATH86% %WLIBVALUES%";
-            }
-            file << "\n";
+    createDir("build/unity");
 
-            file << "set extraOptions=";
-            std::string spaceBuffer = " ";
+    for(int i=0; i<unityBuildCount; i++)
+    {
+        std::string unityName = "build/unity/" + batchName + "_" + std::to_string(i) + ".cpp";
+        
+        if(batchContents[i].empty())
+        {
+            fs::remove(startDir + unityName);
+            continue;
+        }
 
-            if(includeResourceFile)
-            {
-                file << " res/";
-                file << projectName;
-                file << ".res";
-            }
+        writeFileIfChanged(startDir + unityName, "// Generated by cppPS. Do not edit.\n" + batchContents[i]);
+        unityFiles.push_back(unityName);
+    }
 
-            if(!debug)
-            {
-                file << spaceBuffer;
-                file << "-O3";
-            }
-            if(processorType == PROC_TYPE_32BIT)
-            {
-                file << spaceBuffer;
-                file << "-m32";
-            }
-            else if(processorType == PROC_TYPE_64BIT)
-            {
-                file << spaceBuffer;
-                file << "-m64";
-            }
-            if(isGuiApplication)
-            {
-                file << spaceBuffer;
-                file << "-Wl,-subsystem:windows -Wl,-entrypoint:mainCRTStartup";
-            }
-            file << "\n";
+    return unityFiles;
+}
 
-            if(debug)
-            {
-                file << "set projectCommand=./bin/Debug/obj/*.o -o ./bin/Debug/";
-            }
-            else
-            {
-                file << "set projectCommand=./bin/Release/obj/*.o -o ./bin/Release/";
-            }
+std::string getObjectName(const std::string& source)
+{
+    //the whole path of the source with its extension is kept so src/a/util.cpp, src/a/util.c and
+    //src/b/util.cpp never end up as the same object. Sources always start with src/, bench/ or
+    //build/ (the generated ones) so each gets its own folder in obj and cannot clash with the others.
+    return source;
+}
 
-            file << projectName;
-            file << ".exe";
-            file << "\n";
-        }
-        else
-        {
-            file << "set debugOptions=/DEBUG";
+void createObjectDirs(const std::vector<std::string>& sourceFiles)
+{
+    std::set<std::string> objectDirs;
+    for(const std::string& source : sourceFiles)
+    {
+        std::string objectName = getObjectName(source);
+        size_t separatorIndex = objectName.find_last_of('/');
+        if(separatorIndex != SIZE_MAX)
+            objectDirs.insert(objectName.substr(0, separatorIndex));
+    }
 
-            if(extraDebugOptions)
-            {
-                file << " /fsantize=address";
-            }
-            file << "\n";
+    for(const std::string& dir : objectDirs)
+    {
+        std::error_code err;
+        for(int config : getConfigs())
+            fs::create_directories(startDir + "bin/" + getConfigName(config) + "/obj/" + dir, err);
+    }
 
-            file << "set linkOptions=";
-            if(includeWindowsStuff)
-            {
-                if(processorType != PROC_TYPE_32BIT)
-                    file << "%WLIBPATH64% %WLIBVALUES%";
-                else
-                    file << "%WLIBPATH86% %WLIBVALUES%";
-            }
-            file << " res/";
-            file << projectName;
-            file << ".res";
-            file << "\n";
+    if(archType == ARCH_MULTI)
+    {
+        for(int arch : {ARCH_X86_64_V2, ARCH_X86_64_V3, ARCH_X86_64_V4})
+        {
+            std::error_code err;
+            fs::create_directories(startDir + "bin/Release/obj/" + getArchName(arch), err);
+            for(const std::string& dir : objectDirs)
+                fs::create_directories(startDir + "bin/Release/obj/" + getArchName(arch) + "/" + dir, err);
+        }
+    }
+}
 
-            file << "set extraOptions=";
-            std::string spaceBuffer = " ";
+std::string getPCHFile()
+{
+    if(pchHeader.empty())
+        return "";
+    
+    std::string headerName = fs::path(pchHeader).filename().string();
+    if(compilerType == TYPE_CLANG)
+        return "$objDir/" + headerName + ".pch";
+    else if(compilerType == TYPE_MSVC)
+        return "$objDir/" + fs::path(pchHeader).stem().string() + ".pch";
+    else
+        return "$objDir/" + headerName + ".gch";
+}
 
-            if(includeResourceFile)
+std::string getPCHFlags()
+{
+    if(pchHeader.empty())
+        return "";
+    
+    std::string headerName = fs::path(pchHeader).filename().string();
+    if(compilerType == TYPE_CLANG)
+    {
+        return "-include-pch " + getPCHFile();
+    }
+    else if(compilerType == TYPE_MSVC)
+    {
+        //msvc searches the include paths for this name so drop the include folder
+        std::string msvcName = pchHeader;
+        if(msvcName.rfind("include/", 0) == 0)
+            msvcName = msvcName.substr(8);
+        return "/Yu\"" + msvcName + "\" /FI\"" + msvcName + "\" /Fp" + getPCHFile();
+    }
+    else
+    {
+        //gcc uses the .gch file next to the included name when it exists
+        return "-include $objDir/" + headerName + " -Winvalid-pch";
+    }
+}
+
+long long getTotalMemoryMB()
+{
+    //0 when it is not known. The total is used instead of the free memory because
+    //the free memory changes between runs and would rewrite build.ninja every time.
+    #ifdef LINUX
+        std::fstream file("/proc/meminfo", std::fstream::in);
+        std::string name;
+        long long value;
+        std::string unit;
+        while(file >> name >> value >> unit)
+        {
+            if(name == "MemTotal:")
+                return value / 1024;
+        }
+    #endif
+    return 0;
+}
+
+int getPoolDepth(int jobs, long long jobMemoryMB)
+{
+    //no more jobs than cores or than fit in the memory
+    if(jobs > 0)
+        return jobs;
+    
+    long long depth = max(std::thread::hardware_concurrency(), 1u);
+    long long memory = getTotalMemoryMB();
+    if(memory > 0 && memory / jobMemoryMB < depth)
+        depth = memory / jobMemoryMB;
+    return (depth < 1)? 1 : (int)depth;
+}
+
+bool isHeavySource(const std::string& source, const std::vector<std::string>& heavyPatterns)
+{
+    //a source is heavy when it or one of its folders matches
+    std::string fileName = fs::path(source).filename().string();
+    if(matchesPatterns(source, fileName, false, heavyPatterns))
+        return true;
+    
+    size_t index = source.find('/');
+    while(index != SIZE_MAX)
+    {
+        std::string dir = source.substr(0, index);
+        if(matchesPatterns(dir, fs::path(dir).filename().string(), true, heavyPatterns))
+            return true;
+        index = source.find('/', index+1);
+    }
+    return false;
+}
+
+int findTarget(const std::string& name)
+{
+    for(size_t i=0; i<projectTargets.size(); i++)
+    {
+        if(projectTargets[i].name == name)
+            return i;
+    }
+    return -1;
+}
+
+bool hasTargetType(char type)
+{
+    for(const Target& t : projectTargets)
+    {
+        if(t.type == type)
+            return true;
+    }
+    return false;
+}
+
+bool usesArchiveRule()
+{
+    if(projectTargets.empty())
+        return isStaticLibrary;
+    return hasTargetType(TARGET_STATIC);
+}
+
+bool usesSharedRule()
+{
+    if(projectTargets.empty())
+        return isDynamicLibrary;
+    return hasTargetType(TARGET_SHARED);
+}
+
+std::vector<std::pair<std::string, std::string>> getObjectFlags()
+{
+    //flags that build.ninja sets on top of vars.ninja for every object.
+    //compile_commands.json uses the same ones so tools see the real command.
+    std::vector<std::pair<std::string, std::string>> flags;
+    if(usesSharedRule() && compilerType != TYPE_MSVC && !generateBatch)
+    {
+        //objects can be used by any target so they are all position independent.
+        //The precompiled header is built with the same flags so it still matches.
+        flags.push_back({"compilerFlags", "$compilerFlags -fPIC"});
+        flags.push_back({"cFlags", "$cFlags -fPIC"});
+    }
+    if(!pchHeader.empty())
+        flags.push_back({"pchFlags", getPCHFlags()});
+    return flags;
+}
+
+std::string getStaticLibFile(int config)
+{
+    std::string k = "exportStaticLib/" + getConfigName(config) + "/";
+    if(generateBatch || compilerType == TYPE_MSVC)
+        return k + projectName + ".lib";
+    return k + "lib" + projectName + ".a";
+}
+
+std::string getDynamicLibFile(int config)
+{
+    std::string k = "exportDynamicLib/" + getConfigName(config) + "/";
+    if(generateBatch)
+        return k + projectName + ".dll";
+    return k + "lib" + projectName + ".so";
+}
+
+void writeLibraryEdges(std::ostream& file, int config, const std::vector<std::string>& sourceFiles, const std::string& mainSource)
+{
+    //the libraries use the same objects as the executable except the one with main.
+    //Only the objects of current sources are listed so deleted sources never end up in a library.
+    std::string objectList = "";
+    if(compilerType == TYPE_MSVC && !pchHeader.empty())
+        objectList += " $objDir/pch.obj";
+    
+    for(const std::string& source : sourceFiles)
+    {
+        if(source != mainSource)
+            objectList += " $objDir/" + getObjectName(source) + ".o";
+    }
+
+    file << "\n";
+    file << "## build the libraries\n";
+    if(isStaticLibrary)
+    {
+        file << "build " << getStaticLibFile(config) << ": archive" << objectList << "\n";
+        file << "build staticLib: phony " << getStaticLibFile(config) << "\n";
+        file << "default " << getStaticLibFile(config) << "\n";
+    }
+
+    if(isDynamicLibrary)
+    {
+        std::string libFile = getDynamicLibFile(config);
+        file << "build " << libFile;
+        if(generateBatch)
+            file << " | " << libFile.substr(0, libFile.size()-4) << ".lib";
+        file << ": shlib" << objectList << "\n";
+        if(!generateBatch)
+            file << "   soname = " << fs::path(libFile).filename().string() << "\n";
+        file << "build dynamicLib: phony " << libFile << "\n";
+        file << "default " << libFile << "\n";
+    }
+}
+
+bool checkTargetCycle(int index, std::vector<char>& state)
+{
+    //state is 0 when not visited, 1 while its dependencies are visited, and 2 when done
+    if(state[index] == 2)
+        return false;
+    if(state[index] == 1)
+        return true;
+    
+    state[index] = 1;
+    for(const std::string& dep : projectTargets[index].dependencies)
+    {
+        if(checkTargetCycle(findTarget(dep), state))
+            return true;
+    }
+    state[index] = 2;
+    return false;
+}
+
+bool readTargetFile()
+{
+    //Each line is "type name sourceDirs... [: dependencies...]" where type is
+    //executable, static, or shared. Lines starting with # are comments.
+    projectTargets.clear();
+    std::fstream file(startDir + "/targets.txt", std::fstream::in | std::fstream::binary);
+    if(!file.is_open())
+        return true;
+    
+    std::string line;
+    int lineNumber = 0;
+    while(std::getline(file, line))
+    {
+        lineNumber++;
+        size_t commentIndex = line.find('#');
+        if(commentIndex != SIZE_MAX)
+            line = line.substr(0, commentIndex);
+        
+        std::stringstream lineStream(line);
+        std::vector<std::string> parts;
+        std::string part;
+        while(lineStream >> part)
+            parts.push_back(part);
+        
+        if(parts.empty())
+            continue;
+        
+        Target t;
+        if(parts[0] == "executable")
+            t.type = TARGET_EXECUTABLE;
+        else if(parts[0] == "static")
+            t.type = TARGET_STATIC;
+        else if(parts[0] == "shared")
+            t.type = TARGET_SHARED;
+        else
+        {
+            std::cout << "ERROR: targets.txt line " << lineNumber << ": Unknown target type " << parts[0] << std::endl;
+            return false;
+        }
+
+        bool readingDependencies = false;
+        for(size_t i=2; i<parts.size(); i++)
+        {
+            if(parts[i] == ":")
+                readingDependencies = true;
+            else if(readingDependencies)
+                t.dependencies.push_back(parts[i]);
+            else
             {
-                file << " res/";
-                file << projectName;
-                file << ".res";
+                while(parts[i].size() > 1 && parts[i].back() == '/')
+                    parts[i].pop_back();
+                t.sourceDirs.push_back(parts[i]);
             }
+        }
+
+        if(parts.size() < 2 || parts[1] == ":" || t.sourceDirs.empty())
+        {
+            std::cout << "ERROR: targets.txt line " << lineNumber << ": A target needs a name and at least one source folder" << std::endl;
+            return false;
+        }
+        t.name = parts[1];
+
+        if(findTarget(t.name) >= 0)
+        {
+            std::cout << "ERROR: targets.txt line " << lineNumber << ": " << t.name << " is already a target" << std::endl;
+            return false;
+        }
+        projectTargets.push_back(t);
+    }
 
-            if(!debug)
+    for(const Target& t : projectTargets)
+    {
+        for(const std::string& dep : t.dependencies)
+        {
+            int index = findTarget(dep);
+            if(index < 0 || projectTargets[index].type == TARGET_EXECUTABLE)
             {
-                file << spaceBuffer;
-                file << "/O2";
+                std::cout << "ERROR: targets.txt: " << t.name << " depends on " << dep << " which is not a library target" << std::endl;
+                return false;
             }
-            if(processorType == PROC_TYPE_32BIT)
+        }
+    }
+
+    std::vector<char> state = std::vector<char>(projectTargets.size(), 0);
+    for(size_t i=0; i<projectTargets.size(); i++)
+    {
+        if(checkTargetCycle(i, state))
+        {
+            std::cout << "ERROR: targets.txt: The dependencies of " << projectTargets[i].name << " form a cycle" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int getTargetOfSource(const std::string& source)
+{
+    //the longest matching folder wins so a target can be inside the folder of another
+    int bestTarget = -1;
+    size_t bestLength = 0;
+    for(size_t i=0; i<projectTargets.size(); i++)
+    {
+        for(const std::string& dir : projectTargets[i].sourceDirs)
+        {
+            if(source.rfind(dir + "/", 0) == 0 && dir.size() >= bestLength)
             {
-                file << spaceBuffer;
-                file << "/machine:x86";
+                bestTarget = i;
+                bestLength = dir.size();
             }
-            else if(processorType == PROC_TYPE_64BIT)
+        }
+    }
+    return bestTarget;
+}
+
+std::string getTargetOutputFile(const Target& t, int config)
+{
+    std::string k = "./bin/" + getConfigName(config) + "/";
+    if(t.type == TARGET_EXECUTABLE)
+        k += (generateBatch)? t.name + ".exe" : t.name;
+    else if(t.type == TARGET_STATIC)
+        k += (generateBatch || compilerType == TYPE_MSVC)? t.name + ".lib" : "lib" + t.name + ".a";
+    else
+        k += (generateBatch)? t.name + ".dll" : "lib" + t.name + ".so";
+    return k;
+}
+
+std::string getTargetLinkFile(const Target& t, int config)
+{
+    //windows links with the import library that is written next to the dll
+    if(t.type == TARGET_SHARED && generateBatch)
+        return "./bin/" + getConfigName(config) + "/" + t.name + ".lib";
+    return getTargetOutputFile(t, config);
+}
+
+void addTargetLibraries(int index, std::vector<char>& visited, std::vector<int>& order)
+{
+    if(visited[index])
+        return;
+    visited[index] = true;
+
+    //the libraries a shared library uses are already linked into it
+    if(projectTargets[index].type != TARGET_SHARED)
+    {
+        for(const std::string& dep : projectTargets[index].dependencies)
+            addTargetLibraries(findTarget(dep), visited, order);
+    }
+    order.push_back(index);
+}
+
+void writeTargetEdges(std::ostream& file, int config, const std::vector<std::vector<std::string>>& targetSources, const std::string& sharedObjects)
+{
+    //every object is built once above. Each target links its own objects and the
+    //libraries it depends on so ninja can build targets that do not depend on each other at once.
+    std::string defaultList = "";
+    for(size_t i=0; i<projectTargets.size(); i++)
+    {
+        const Target& t = projectTargets[i];
+        std::string outputFile = getTargetOutputFile(t, config);
+        
+        //dependencies are listed before the libraries they use for static linking
+        std::vector<char> visited = std::vector<char>(projectTargets.size(), false);
+        std::vector<int> order;
+        for(const std::string& dep : t.dependencies)
+            addTargetLibraries(findTarget(dep), visited, order);
+        std::reverse(order.begin(), order.end());
+
+        std::string objectList = sharedObjects;
+        for(const std::string& source : targetSources[i])
+            objectList += " $objDir/" + getObjectName(source) + ".o";
+
+        //a static library only holds its own objects. The libraries it needs are linked by its users.
+        bool usesSharedLibrary = false;
+        if(t.type != TARGET_STATIC)
+        {
+            for(int dep : order)
+            {
+                objectList += " " + getTargetLinkFile(projectTargets[dep], config);
+                if(projectTargets[dep].type == TARGET_SHARED)
+                    usesSharedLibrary = true;
+            }
+        }
+
+        if(i > 0)
+            file << "\n";
+        file << "build " << outputFile;
+        if(t.type == TARGET_SHARED && generateBatch)
+            file << " | " << getTargetLinkFile(t, config);
+        
+        if(t.type == TARGET_EXECUTABLE)
+            file << ": link" << objectList << "\n";
+        else if(t.type == TARGET_STATIC)
+            file << ": archive" << objectList << "\n";
+        else
+            file << ": shlib" << objectList << "\n";
+        
+        if(t.type == TARGET_SHARED && !generateBatch)
+            file << "   soname = " << fs::path(outputFile).filename().string() << "\n";
+
+        //shared libraries are found next to the executable without setting LD_LIBRARY_PATH
+        if(usesSharedLibrary && !generateBatch)
+            file << "   linkFlags = $linkFlags '-Wl,-rpath,$$ORIGIN'\n";
+        
+        file << "build " << t.name << ": phony " << outputFile << "\n";
+        defaultList += " " + outputFile;
+    }
+    file << "default" << defaultList << "\n";
+}
+
+void writeNinjaFile(std::ostream& file, int config, const std::vector<std::string>& sourceFiles, const std::vector<std::vector<std::string>>& targetSources, const std::vector<std::string>& benchFiles, const std::string& mainSource)
+{
+    if(file.good())
+    {
+        file << "# Processor Type set to ";
+        if(processorType == PROC_TYPE_32BIT)
+            file << "32 bit\n";
+        else if(processorType == PROC_TYPE_64BIT)
+            file << "64 bit\n";
+        else
+            file << "UNKNOWN TYPE\n";
+        
+        file << "# Include variables for this build\n";
+        file << "include ./build/" << getConfigName(config) << "/vars.ninja\n\n";
+
+        file << "## for getting object files\n";
+        file << "## This also gets dependencies\n";
+        bool hasCSources = std::any_of(sourceFiles.begin(), sourceFiles.end(), isCSource);
+
+        if(compilerType != TYPE_MSVC)
+        {
+            file << "rule buildToObject\n";
+            file << "   deps = gcc\n";
+            file << "   depfile = $out.d\n";
+            if(traceBuild && compilerType == TYPE_CLANG)
+                file << "   command = $compiler $compilerFlags $archFlags $pchFlags $inc $in -o $out -MMD -MF $out.d -ftime-trace\n";
+            else
+                file << "   command = $compiler $compilerFlags $archFlags $pchFlags $inc $in -o $out -MMD -MF $out.d\n";
+            file << "\n";
+
+            if(useModules)
+            {
+                //every source is scanned for the modules it provides and imports. cppPS collects
+                //the scans into a dyndep file that orders the builds and a response file for each
+                //object with the module flags.
+                file << "## for finding the modules used by each source\n";
+                file << "rule scanModules\n";
+                file << "   deps = gcc\n";
+                file << "   depfile = $out.d\n";
+                if(compilerType == TYPE_CLANG && generateBatch)
+                    file << "   command = cmd /c $moduleScanner $compilerFlags $archFlags $inc $scanLanguage $in -o $obj -MT $out -MD -MF $out.d > $out\n";
+                else if(compilerType == TYPE_CLANG)
+                    file << "   command = $moduleScanner $compilerFlags $archFlags $inc $scanLanguage $in -o $obj -MT $out -MD -MF $out.d > $out\n";
+                else
+                    file << "   command = $moduleScanner $compilerFlags $archFlags $inc -E -x c++ $in -MT $out -MD -MF $out.d -fdeps-format=p1689r5 -fdeps-file=$out -fdeps-target=$obj -o $out.i\n";
+                file << "\n";
+
+                file << "## for ordering the module builds\n";
+                file << "rule collateModules\n";
+                file << "   command = \"" << toolPath << "\" -collate-modules $out $objDir " << getCompilerTypeName() << " $in\n";
+                file << "   restat = 1\n";
+                file << "\n";
+
+                file << "## for building sources that use modules\n";
+                file << "rule buildModuleToObject\n";
+                file << "   deps = gcc\n";
+                file << "   depfile = $out.d\n";
+                file << "   command = $compiler $compilerFlags $archFlags $pchFlags $inc @$out.modmap $in -o $out -MMD -MF $out.d\n";
+                file << "\n";
+            }
+
+            if(hasCSources)
+            {
+                //c files do not use the c++ precompiled header
+                file << "## for building c files\n";
+                file << "rule buildCToObject\n";
+                file << "   deps = gcc\n";
+                file << "   depfile = $out.d\n";
+                if(traceBuild && compilerType == TYPE_CLANG)
+                    file << "   command = $compiler $cFlags $archFlags $inc -x c $in -o $out -MMD -MF $out.d -ftime-trace\n";
+                else
+                    file << "   command = $compiler $cFlags $archFlags $inc -x c $in -o $out -MMD -MF $out.d\n";
+                file << "\n";
+            }
+
+            if(!pchHeader.empty())
+            {
+                file << "## for building the precompiled header\n";
+                file << "rule buildPCH\n";
+                file << "   deps = gcc\n";
+                file << "   depfile = $out.d\n";
+                file << "   command = $compiler $compilerFlags $inc -x c++-header $in -o $out -MMD -MF $out.d\n";
+                file << "\n";
+            }
+
+            if(config == CONFIG_PGO)
+            {
+                //the depfile lists every profile so one that is written again in place
+                //is seen. A new profile changes the folder itself.
+                file << "## for merging the profiles written by the instrumented build\n";
+                file << "rule mergeProfile\n";
+                file << "   deps = gcc\n";
+                file << "   depfile = $out.d\n";
+                file << "   command = \"" << toolPath << "\" -merge-profiles $out $in " << getCompilerTypeName() << "\n";
+                file << "\n";
+            }
+
+            file << "## for linking the objects into the executable\n";
+            file << "rule link\n";
+            file << "   command = $compiler $linkFlags $in -o $out $libs\n";
+            file << "   pool = link_pool\n";
+            file << "\n";
+
+            if(usesArchiveRule())
             {
-                file << spaceBuffer;
-                file << "/machine:x64";
+                //the old archive is removed first so objects from deleted sources do not stay in it
+                file << "## for archiving objects into a static library\n";
+                file << "rule archive\n";
+                if(!generateBatch)
+                    file << "   command = rm -f $out && " << getArchiver() << " rcs $out $in\n";
+                else if(compilerType == TYPE_CLANG)
+                    file << "   command = llvm-lib /OUT:$out $in\n";
+                else
+                    file << "   command = " << getArchiver() << " rcs $out $in\n";
+                file << "\n";
             }
-            if(isGuiApplication)
+
+            if(usesSharedRule())
             {
-                file << spaceBuffer;
-                file << "/subsystem:windows /entrypoint:mainCRTStartup";
+                //the soname is stored in executables instead of the path to the library
+                file << "## for linking objects into a shared library\n";
+                file << "rule shlib\n";
+                if(!generateBatch)
+                    file << "   command = $compiler $linkFlags -shared -Wl,-soname,$soname $in -o $out $libs\n";
+                else
+                    file << "   command = $compiler $linkFlags -shared $in -o $out $libs\n";
+                file << "   pool = link_pool\n";
+                file << "\n";
             }
+        }
+        else
+        {
+            file << "rule buildToObject\n";
+            file << "   deps = msvc\n";
+            file << "   command = $compiler $compilerFlags $archFlags $pchFlags $inc $in /showIncludes /Fo$out\n";
             file << "\n";
 
-            if(debug)
+            if(useModules)
+            {
+                file << "## for finding the modules used by each source\n";
+                file << "rule scanModules\n";
+                file << "   command = $moduleScanner $compilerFlags $inc /TP /scanDependencies $out $in /Fo$obj\n";
+                file << "\n";
+
+                file << "## for ordering the module builds\n";
+                file << "rule collateModules\n";
+                file << "   command = \"" << toolPath << "\" -collate-modules $out $objDir " << getCompilerTypeName() << " $in\n";
+                file << "   restat = 1\n";
+                file << "\n";
+
+                file << "## for building sources that use modules\n";
+                file << "rule buildModuleToObject\n";
+                file << "   deps = msvc\n";
+                file << "   command = $compiler $compilerFlags $archFlags $pchFlags $inc @$out.modmap $in /showIncludes /Fo$out\n";
+                file << "\n";
+            }
+
+            if(hasCSources)
             {
-                file << "set projectCommand=/LINK ./bin/Debug/obj/*.o /OUT:./bin/Debug/";
+                file << "## for building c files\n";
+                file << "rule buildCToObject\n";
+                file << "   deps = msvc\n";
+                file << "   command = $compiler $cFlags $archFlags $inc /TC $in /showIncludes /Fo$out\n";
+                file << "\n";
             }
-            else
+
+            if(!pchHeader.empty())
+            {
+                std::string msvcName = pchHeader;
+                if(msvcName.rfind("include/", 0) == 0)
+                    msvcName = msvcName.substr(8);
+                
+                file << "## for building the precompiled header\n";
+                file << "rule buildPCH\n";
+                file << "   deps = msvc\n";
+                file << "   command = $compiler $compilerFlags $inc /Yc\"" << msvcName << "\" /FI\"" << msvcName << "\" /Fp$out $in /showIncludes /Fo$objDir/pch.obj\n";
+                file << "\n";
+            }
+
+            file << "## for linking the objects into the executable\n";
+            file << "rule link\n";
+            file << "   command = $compiler $linkFlags /LINK $linkerFlags $in $libs /OUT:$out\n";
+            file << "   pool = link_pool\n";
+            file << "\n";
+
+            if(usesArchiveRule())
+            {
+                file << "## for archiving objects into a static library\n";
+                file << "rule archive\n";
+                file << "   command = lib /nologo /OUT:$out $in\n";
+                file << "\n";
+            }
+
+            if(usesSharedRule())
             {
-                file << "set projectCommand=/LINK ./bin/Release/obj/*.o /OUT:./bin/Release/";
+                //the import library is written next to the dll
+                file << "## for linking objects into a shared library\n";
+                file << "rule shlib\n";
+                file << "   command = $compiler $linkFlags /LINK /DLL $linkerFlags $in $libs /OUT:$out\n";
+                file << "   pool = link_pool\n";
+                file << "\n";
             }
+        }
+
+        //proceed to build all objects using the same syntax as this
+        //build $objDir/Person.o: buildToObject src/Person.cpp
 
-            file << projectName;
-            file << ".exe";
+        //links and heavy compiles can use a lot of memory so only some of them run at once
+        int linkDepth = getPoolDepth(linkJobs, (getLTOFlags(config) != "")? LTO_LINK_JOB_MB : LINK_JOB_MB);
+        int heavyDepth = getPoolDepth(heavyJobs, HEAVY_JOB_MB);
+        file << "## limits how many jobs that use a lot of memory run at once\n";
+        file << "pool link_pool\n";
+        file << "   depth = " << linkDepth << "\n";
+        file << "\n";
+        if(!heavySources.empty())
+        {
+            file << "pool heavy_compile_pool\n";
+            file << "   depth = " << heavyDepth << "\n";
             file << "\n";
         }
+
+        file << "## build all of the objects and the executable\n";
+        std::string objectList = "";
+        std::string pchFile = getPCHFile();
+        std::string pchDependency = "";
+        std::string profileDependency = "";
+        std::string scanList = "";
+        std::string modmapList = "";
+
+        for(const std::pair<std::string, std::string>& flags : getObjectFlags())
+            file << flags.first << " = " << flags.second << "\n";
+
+        if(!pchHeader.empty())
+        {
+            //every object depends on the precompiled header so it is built first
+            if(compilerType != TYPE_MSVC)
+            {
+                file << "build " << pchFile << ": buildPCH " << pchHeader << "\n";
+            }
+            else
+            {
+                //msvc needs a source file to create the precompiled header from
+                file << "build " << pchFile << " | $objDir/pch.obj: buildPCH build/pch.cpp\n";
+                objectList += " $objDir/pch.obj";
+            }
+            pchDependency = " " + pchFile;
+        }
+
+        if(config == CONFIG_PGO)
+        {
+            //clang merges the profiles into one file. gcc reads them itself so only a
+            //list of them is written to rebuild the objects when they change.
+            std::string profileFile = (compilerType == TYPE_CLANG)? "./build/PGO/default.profdata" : "./build/PGO/profiles.stamp";
+            file << "build " << profileFile << ": mergeProfile ./bin/Instrumented/profiles\n";
+            profileDependency = " " + profileFile;
+        }
+
+        for(const std::string& source : sourceFiles)
+        {
+            std::string nameString = getObjectName(source);
+
+            if(useModules && !isCSource(source))
+            {
+                file << "build $objDir/" << nameString << ".ddi: scanModules " << source << "\n";
+                file << "   obj = $objDir/" << nameString << ".o\n";
+                if(compilerType == TYPE_CLANG && fs::path(source).extension() == ".ixx")
+                    file << "   scanLanguage = -x c++-module\n";
+                
+                file << "build $objDir/" << nameString << ".o: buildModuleToObject " << source;
+                file << " | $objDir/" << nameString << ".o.modmap" << pchDependency << profileDependency;
+                file << " || $objDir/modules.dd\n";
+                file << "   dyndep = $objDir/modules.dd\n";
+                if(heavySources.count(source) > 0)
+                    file << "   pool = heavy_compile_pool\n";
+
+                scanList += " $objDir/" + nameString + ".ddi";
+                modmapList += " $objDir/" + nameString + ".o.modmap";
+            }
+            else
+            {
+                file << "build $objDir/";
+                file << nameString;
+                file << (isCSource(source)? ".o: buildCToObject " : ".o: buildToObject ");
+                file << source;
+
+                //c files do not use the c++ precompiled header but still use the profiles
+                std::string dependencies = (isCSource(source))? profileDependency : pchDependency + profileDependency;
+                if(!dependencies.empty())
+                    file << " |" << dependencies;
+                file << "\n";
+                if(heavySources.count(source) > 0)
+                    file << "   pool = heavy_compile_pool\n";
+            }
+
+            objectList += " $objDir/" + nameString + ".o";
+        }
+
+        if(useModules)
+        {
+            //the module map is only used by gcc
+            file << "build $objDir/modules.dd |" << modmapList;
+            if(compilerType == TYPE_GCC)
+                file << " $objDir/modules.map";
+            file << ": collateModules" << scanList << "\n";
+        }
+
+        //the executable is only relinked when one of its objects changes
+        file << "\n";
+        if(!projectTargets.empty())
+        {
+            std::string sharedObjects = "";
+            if(compilerType == TYPE_MSVC && !pchHeader.empty())
+                sharedObjects = " $objDir/pch.obj";
+            writeTargetEdges(file, config, targetSources, sharedObjects);
+        }
+        else if(config == CONFIG_RELEASE && archType == ARCH_MULTI)
+        {
+            //the objects above are the baseline build. Each level gets its own objects and
+            //executable. $outputFile becomes a launcher that starts the best one.
+            std::string defaultList = "";
+            file << "build " << getArchOutputFile(ARCH_DEFAULT) << ": link" << objectList << "\n";
+            defaultList += " " + getArchOutputFile(ARCH_DEFAULT);
+
+            for(int arch : {ARCH_X86_64_V2, ARCH_X86_64_V3, ARCH_X86_64_V4})
+            {
+                std::string archName = getArchName(arch);
+                std::string archObjectList = "";
+                file << "\n";
+                for(const std::string& source : sourceFiles)
+                {
+                    std::string nameString = archName + "/" + getObjectName(source);
+                    file << "build $objDir/" << nameString << (isCSource(source)? ".o: buildCToObject " : ".o: buildToObject ") << source << "\n";
+                    file << "   archFlags =" << getArchFlags(arch) << "\n";
+                    file << "   pchFlags =\n";
+                    if(heavySources.count(source) > 0)
+                        file << "   pool = heavy_compile_pool\n";
+                    archObjectList += " $objDir/" + nameString + ".o";
+                }
+                file << "build " << getArchOutputFile(arch) << ": link" << archObjectList << "\n";
+                file << "   linkFlags = $linkFlags" << getArchFlags(arch) << "\n";
+                defaultList += " " + getArchOutputFile(arch);
+            }
+
+            file << "\n";
+            file << "build $objDir/cppps_launcher.o: buildToObject build/cppps_launcher.cpp\n";
+            file << "   pchFlags =\n";
+            file << "build $outputFile: link $objDir/cppps_launcher.o\n";
+            file << "default $outputFile" << defaultList << "\n";
+        }
+        else
+        {
+            file << "build $outputFile: link" << objectList << "\n";
+            file << "default $outputFile\n";
+        }
+
+        if(projectTargets.empty() && (isStaticLibrary || isDynamicLibrary))
+        {
+            writeLibraryEdges(file, config, sourceFiles, mainSource);
+        }
+
+        if(config == CONFIG_RELEASE && includeBenchmarks)
+        {
+            //benchmarks are linked with every object except the one with main
+            //and are only built when asked for with "ninja bench"
+            std::string benchObjectList = "";
+            if(compilerType == TYPE_MSVC && !pchHeader.empty())
+                benchObjectList += " $objDir/pch.obj";
+            
+            for(const std::string& source : sourceFiles)
+            {
+                if(source != mainSource)
+                    benchObjectList += " $objDir/" + getObjectName(source) + ".o";
+            }
+
+            file << "\n";
+            file << "## build the benchmarks\n";
+            for(const std::string& source : benchFiles)
+            {
+                std::string nameString = getObjectName(source);
+                file << "build $objDir/" << nameString << ".o: buildToObject " << source;
+                if(!pchDependency.empty() || !profileDependency.empty())
+                    file << " |" << pchDependency << profileDependency;
+                file << "\n";
+                benchObjectList += " $objDir/" + nameString + ".o";
+            }
+
+            file << "build " << getBenchOutputFile() << ": link" << benchObjectList << "\n";
+            if(compilerType == TYPE_MSVC)
+                file << "   libs = benchmark.lib shlwapi.lib\n";
+            else
+                file << "   libs = -lbenchmark -lpthread\n";
+            file << "build bench: phony " << getBenchOutputFile() << "\n";
+        }
+    }
+}
+
+std::string expandNinjaVars(const std::string& value, const std::map<std::string, std::string>& vars)
+{
+    std::string k = "";
+    for(size_t i=0; i<value.size(); i++)
+    {
+        if(value[i] != '$' || i+1 >= value.size())
+        {
+            k += value[i];
+            continue;
+        }
+
+        if(value[i+1] == '$')
+        {
+            k += '$';
+            i++;
+            continue;
+        }
+
+        size_t start = i+1;
+        size_t end = start;
+        if(value[start] == '{')
+        {
+            start++;
+            end = value.find('}', start);
+            if(end == SIZE_MAX)
+                end = value.size();
+            i = end;
+        }
+        else
+        {
+            while(end < value.size() && (std::isalnum((unsigned char)value[end]) || value[end] == '_' || value[end] == '-'))
+                end++;
+            i = end-1;
+        }
+
+        auto it = vars.find(value.substr(start, end-start));
+        if(it != vars.end())
+            k += it->second;
+    }
+    return k;
+}
+
+std::map<std::string, std::string> readNinjaVars(std::string filename)
+{
+    //reads the simple "name = value" lines that vars.ninja is made of.
+    //values are expanded as they are read just like ninja does.
+    std::map<std::string, std::string> vars;
+    std::fstream file(filename, std::fstream::in | std::fstream::binary);
+    std::string line;
+
+    while(std::getline(file, line))
+    {
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+        
+        size_t index = line.find('=');
+        if(line.empty() || line[0] == '#' || line[0] == ' ' || index == SIZE_MAX)
+            continue;
+        
+        std::string name = line.substr(0, index);
+        std::string value = line.substr(index+1);
+        while(!name.empty() && name.back() == ' ')
+            name.pop_back();
+        while(!value.empty() && value.front() == ' ')
+            value.erase(value.begin());
+        
+        vars[name] = expandNinjaVars(value, vars);
+    }
+    return vars;
+}
+
+std::string escapeJson(const std::string& value)
+{
+    std::string k = "";
+    for(char c : value)
+    {
+        if(c == '\\' || c == '"')
+            k += '\\';
+        k += c;
+    }
+    return k;
+}
+
+void skipJsonSpace(const std::string& text, size_t& index)
+{
+    while(index < text.size() && std::isspace((unsigned char)text[index]))
+        index++;
+}
+
+bool parseJsonString(const std::string& text, size_t& index, std::string& value)
+{
+    //index is at the opening quote. Unicode escapes are kept as ? since
+    //only names and paths are needed from the files that are read.
+    index++;
+    while(index < text.size() && text[index] != '"')
+    {
+        if(text[index] == '\\' && index+1 < text.size())
+        {
+            index++;
+            char c = text[index];
+            if(c == 'n')
+                value += '\n';
+            else if(c == 't')
+                value += '\t';
+            else if(c == 'r')
+                value += '\r';
+            else if(c == 'b' || c == 'f')
+                value += ' ';
+            else if(c == 'u')
+            {
+                value += '?';
+                index += 4;
+            }
+            else
+                value += c;
+        }
+        else
+            value += text[index];
+        index++;
+    }
+
+    if(index >= text.size())
+        return false;
+    index++;
+    return true;
+}
+
+bool parseJsonValue(const std::string& text, size_t& index, JsonValue& value)
+{
+    skipJsonSpace(text, index);
+    if(index >= text.size())
+        return false;
+    
+    char c = text[index];
+    if(c == '{')
+    {
+        value.type = JSON_OBJECT;
+        index++;
+        skipJsonSpace(text, index);
+        if(index < text.size() && text[index] == '}')
+        {
+            index++;
+            return true;
+        }
+
+        while(index < text.size())
+        {
+            std::string name = "";
+            skipJsonSpace(text, index);
+            if(index >= text.size() || text[index] != '"' || !parseJsonString(text, index, name))
+                return false;
+            
+            skipJsonSpace(text, index);
+            if(index >= text.size() || text[index] != ':')
+                return false;
+            index++;
+
+            value.members.push_back({name, JsonValue()});
+            if(!parseJsonValue(text, index, value.members.back().second))
+                return false;
+            
+            skipJsonSpace(text, index);
+            if(index < text.size() && text[index] == ',')
+                index++;
+            else if(index < text.size() && text[index] == '}')
+            {
+                index++;
+                return true;
+            }
+            else
+                return false;
+        }
+        return false;
+    }
+    else if(c == '[')
+    {
+        value.type = JSON_ARRAY;
+        index++;
+        skipJsonSpace(text, index);
+        if(index < text.size() && text[index] == ']')
+        {
+            index++;
+            return true;
+        }
+
+        while(index < text.size())
+        {
+            value.items.push_back(JsonValue());
+            if(!parseJsonValue(text, index, value.items.back()))
+                return false;
+            
+            skipJsonSpace(text, index);
+            if(index < text.size() && text[index] == ',')
+                index++;
+            else if(index < text.size() && text[index] == ']')
+            {
+                index++;
+                return true;
+            }
+            else
+                return false;
+        }
+        return false;
+    }
+    else if(c == '"')
+    {
+        value.type = JSON_STRING;
+        return parseJsonString(text, index, value.text);
+    }
+    else if(text.compare(index, 4, "true") == 0 || text.compare(index, 5, "false") == 0)
+    {
+        value.type = JSON_BOOL;
+        value.boolean = (c == 't');
+        index += (value.boolean)? 4 : 5;
+        return true;
+    }
+    else if(text.compare(index, 4, "null") == 0)
+    {
+        value.type = JSON_NULL;
+        index += 4;
+        return true;
+    }
+    else
+    {
+        const char* start = text.c_str() + index;
+        char* end = nullptr;
+        value.type = JSON_NUMBER;
+        value.number = std::strtod(start, &end);
+        if(end == start)
+            return false;
+        index += end - start;
+        return true;
+    }
+}
+
+bool readJsonFile(std::string filename, JsonValue& value)
+{
+    std::fstream file(filename, std::fstream::in | std::fstream::binary);
+    if(!file.is_open())
+        return false;
+    
+    std::stringstream content;
+    content << file.rdbuf();
+    file.close();
+
+    size_t index = 0;
+    return parseJsonValue(content.str(), index, value);
+}
+
+std::string getCompileCommands(const std::vector<std::string>& sourceFiles, int config)
+{
+    //uses the values from vars.ninja so any changes made to it by hand are included
+    std::string varFile = "build/" + getConfigName(config) + "/vars.ninja";
+    std::map<std::string, std::string> vars = readNinjaVars(startDir + varFile);
+
+    //projects made before c files were supported do not have cFlags
+    if(vars.count("cFlags") == 0)
+        vars["cFlags"] = vars["compilerFlags"];
+    for(const std::pair<std::string, std::string>& flags : getObjectFlags())
+        vars[flags.first] = expandNinjaVars(flags.second, vars);
+
+    //tools run the compiler directly so the batch file wrapper is not needed
+    std::string compiler = vars["compiler"];
+    if(compiler.rfind("cmd /c ", 0) == 0)
+        compiler = compiler.substr(7);
+    if(compiler.rfind("ccache ", 0) == 0)
+        compiler = compiler.substr(7);
+    else if(compiler.rfind("sccache ", 0) == 0)
+        compiler = compiler.substr(8);
+    
+    std::string directory = fs::absolute(startDir).lexically_normal().string();
+    if(directory.size() > 1 && (directory.back() == '/' || directory.back() == '\\'))
+        directory.pop_back();
+    
+    std::string k = "[\n";
+    for(size_t i=0; i<sourceFiles.size(); i++)
+    {
+        std::string objectFile = vars["objDir"] + "/" + getObjectName(sourceFiles[i]) + ".o";
+        std::string command = compiler;
+        if(!isCSource(sourceFiles[i]))
+        {
+            command += " " + vars["compilerFlags"];
+            if(!vars["pchFlags"].empty())
+                command += " " + vars["pchFlags"];
+        }
+        else
+        {
+            command += " " + vars["cFlags"];
+            command += (compilerType != TYPE_MSVC)? " -x c" : " /TC";
+        }
+        command += " " + vars["inc"] + " " + sourceFiles[i];
+
+        if(compilerType != TYPE_MSVC)
+            command += " -o " + objectFile;
+        else
+            command += " /Fo" + objectFile;
+        
+        //the shell fills in the current folder when ninja runs but tools do not
+        for(std::string folderVar : {"$PWD", "%CD%"})
+        {
+            size_t index = command.find(folderVar);
+            if(index != SIZE_MAX)
+                command.replace(index, folderVar.size(), directory);
+        }
+        
+        k += "\t{\n";
+        k += "\t\t\"directory\": \"" + escapeJson(directory) + "\",\n";
+        k += "\t\t\"command\": \"" + escapeJson(command) + "\",\n";
+        k += "\t\t\"file\": \"" + escapeJson(sourceFiles[i]) + "\",\n";
+        k += "\t\t\"output\": \"" + escapeJson(objectFile) + "\"\n";
+        k += (i+1 < sourceFiles.size())? "\t},\n" : "\t}\n";
+    }
+    k += "]\n";
+    return k;
+}
+
+void createCompileCommands(const std::vector<std::string>& sourceFiles)
+{
+    for(int config : getConfigs())
+    {
+        std::string commands = getCompileCommands(sourceFiles, config);
+        writeFileIfChanged(startDir + "build/" + getConfigName(config) + "/compile_commands.json", commands);
+
+        //tools look for the database in the project folder. It uses the debug build.
+        if(config == CONFIG_DEBUG)
+            writeFileIfChanged(startDir + "compile_commands.json", commands);
+    }
+}
+
+void createNinjaFile(std::vector<std::string> sourceFiles)
+{
+    if(!readTargetFile())
+    {
+        std::cout << "Building a single executable instead." << std::endl;
+        projectTargets.clear();
+    }
+
+    std::vector<std::string> benchFiles;
+    std::string mainSource = "";
+    if(includeBenchmarks)
+    {
+        std::error_code err;
+        if(fs::is_directory(startDir + "/bench", err))
+        {
+            std::vector<std::string> files;
+            addSubDirStuff(files, startDir + "/bench", "bench/");
+            for(const std::string& source : files)
+            {
+                if(!isCSource(source))
+                    benchFiles.push_back(source);
+            }
+            std::sort(benchFiles.begin(), benchFiles.end());
+        }
+    }
+
+    if(includeBenchmarks || isStaticLibrary || isDynamicLibrary)
+    {
+        mainSource = findMainSource(sourceFiles);
+    }
+
+    heavySources.clear();
+    std::vector<std::string> heavyPatterns = readPatternFile(".cppsheavy");
+    if(!heavyPatterns.empty())
+    {
+        for(const std::string& source : sourceFiles)
+        {
+            if(isHeavySource(source, heavyPatterns))
+                heavySources.insert(source);
+        }
+    }
+
+    //tools need each source file by itself even when using unity files
+    std::vector<std::string> allFiles = sourceFiles;
+    allFiles.insert(allFiles.end(), benchFiles.begin(), benchFiles.end());
+    createCompileCommands(allFiles);
+
+    if(!projectTargets.empty())
+    {
+        //sources outside of every target are not built or batched
+        std::vector<std::string> usedFiles;
+        int unusedCount = 0;
+        for(const std::string& source : sourceFiles)
+        {
+            if(getTargetOfSource(source) >= 0)
+                usedFiles.push_back(source);
+            else
+                unusedCount++;
+        }
+        
+        if(unusedCount > 0)
+            std::cout << "WARNING: " << unusedCount << " source file(s) are not in the folders of any target in targets.txt" << std::endl;
+        sourceFiles = usedFiles;
+    }
+
+    std::map<std::string, int> unityTargets;
+    if(unityBuildCount > 0)
+    {
+        //c files can not be included in a c++ batch, heavy files are built alone in their pool,
+        //and the file with main stays out of the batches so the benchmarks can leave it out
+        std::vector<std::string> batchedFiles;
+        std::vector<std::string> separateFiles;
+        for(const std::string& source : sourceFiles)
+        {
+            if(isCSource(source) || isModuleUnit(source) || source == mainSource || heavySources.count(source) > 0)
+                separateFiles.push_back(source);
+            else
+                batchedFiles.push_back(source);
+        }
+        
+        //each target gets its own batches so a batch never mixes the sources of two targets
+        std::map<int, std::vector<std::string>> batchedTargetFiles;
+        for(const std::string& source : batchedFiles)
+            batchedTargetFiles[getTargetOfSource(source)].push_back(source);
+        
+        sourceFiles.clear();
+        for(const auto& it : batchedTargetFiles)
+        {
+            std::string batchName = (it.first >= 0)? projectTargets[it.first].name : "unity";
+            for(const std::string& unityFile : createUnityFiles(it.second, batchName))
+            {
+                unityTargets[unityFile] = it.first;
+                sourceFiles.push_back(unityFile);
+            }
+        }
+        sourceFiles.insert(sourceFiles.end(), separateFiles.begin(), separateFiles.end());
+
+        //batches of targets that were removed or renamed are not built any more
+        std::error_code err;
+        for(const fs::directory_entry& f : fs::directory_iterator(startDir + "build/unity", err))
+        {
+            if(unityTargets.count("build/unity/" + f.path().filename().string()) == 0)
+                fs::remove(f.path(), err);
+        }
+    }
+
+    std::vector<std::vector<std::string>> targetSources = std::vector<std::vector<std::string>>(projectTargets.size());
+    for(const std::string& source : sourceFiles)
+    {
+        int target = (unityTargets.count(source) > 0)? unityTargets[source] : getTargetOfSource(source);
+        if(target >= 0)
+            targetSources[target].push_back(source);
+    }
+
+    createObjectDirs(sourceFiles);
+    createObjectDirs(benchFiles);
+
+    if(archType == ARCH_MULTI)
+        writeFileIfChanged(startDir + "build/cppps_launcher.cpp", getLauncherSource());
+
+    if(!pchHeader.empty())
+    {
+        if(!fs::exists(startDir + pchHeader))
+            std::cout << "WARNING: Precompiled header " << pchHeader << " does not exist yet." << std::endl;
+        
+        if(compilerType == TYPE_MSVC)
+            writeFileIfChanged(startDir + "build/pch.cpp", "// Generated by cppPS. Used to create the precompiled header.\n");
+    }
+
+    //generated in memory first and only written when different so an
+    //unchanged project keeps the same build.ninja and ninja does no work.
+    for(int config : getConfigs())
+    {
+        std::stringstream file;
+        writeNinjaFile(file, config, sourceFiles, targetSources, benchFiles, mainSource);
+        if(writeFileIfChanged(startDir + "/build/" + getConfigName(config) + "/build.ninja", file.str()) == WRITE_UNCHANGED)
+            std::cout << getConfigName(config) << " build.ninja is up to date" << std::endl;
+    }
+}
+
+size_t createNinjaFile()
+{
+    //folders from the last run are only read again when they changed.
+    //Returns how many folders in src had to be read.
+    auto startTime = std::chrono::steady_clock::now();
+    std::string sourceFilter = getSourceFilter();
+    if(dirIndexFilter != sourceFilter)
+        dirIndex.clear();
+    dirIndexFilter = sourceFilter;
+
+    std::vector<std::string> sourceFiles;
+    size_t foldersRead = addSubDirStuff(sourceFiles, startDir+"/src", "src/", &dirIndex);
+
+    //sorted so the generated files are the same every time for the same sources
+    std::sort(sourceFiles.begin(), sourceFiles.end());
+    auto scanTime = std::chrono::steady_clock::now();
+
+    createNinjaFile(sourceFiles);
+    writeStateFile();
+    auto endTime = std::chrono::steady_clock::now();
+
+    std::cout << "Found " << sourceFiles.size() << " files in src in ";
+    std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(scanTime - startTime).count() << " ms. ";
+    std::cout << "Read " << foldersRead << " of " << dirIndex.size() << " folders. ";
+    std::cout << "Writing the build files took ";
+    std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - scanTime).count() << " ms." << std::endl;
+    return foldersRead;
+}
+
+#ifdef LINUX
+
+void addWatchDirs(int fd, std::map<int, std::string>& watchDirs, std::string dir, std::string dirName, const std::vector<std::string>& ignorePatterns)
+{
+    int wd = inotify_add_watch(fd, dir.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE);
+    if(wd >= 0)
+        watchDirs[wd] = dirName;
+
+    //the folder can be gone again before it is read (editor temp folders, git checkout)
+    //so every step uses the error_code overloads and stops when it is gone.
+    std::error_code err;
+    for(fs::directory_iterator it(dir, err); !err && it != fs::directory_iterator(); it.increment(err))
+    {
+        //ignored folders are not watched just like they are not read
+        std::error_code typeErr;
+        std::string fileName = it->path().filename().string();
+        if(it->is_directory(typeErr) && !matchesPatterns(dirName + fileName, fileName, true, ignorePatterns))
+            addWatchDirs(fd, watchDirs, it->path().string(), dirName + fileName + "/", ignorePatterns);
+    }
+}
+
+void removeWatchDirs(int fd, std::map<int, std::string>& watchDirs, std::string dirName)
+{
+    for(auto it = watchDirs.begin(); it != watchDirs.end();)
+    {
+        if(it->second.rfind(dirName, 0) == 0)
+        {
+            inotify_rm_watch(fd, it->first);
+            it = watchDirs.erase(it);
+        }
+        else
+            it++;
+    }
+}
+
+void watchProject()
+{
+    int fd = inotify_init1(IN_CLOEXEC);
+    if(fd < 0)
+    {
+        std::cout << "ERROR: Could not start watching the src folder." << std::endl;
+        return;
+    }
+
+    //the source list is kept in memory and only changed by the events
+    //so the src folder does not have to be walked again for each change.
+    std::vector<std::string> scannedFiles;
+    addSubDirStuff(scannedFiles, startDir+"/src", "src/");
+    std::set<std::string> sourceFiles = std::set<std::string>(scannedFiles.begin(), scannedFiles.end());
+
+    //new files and folders go through the same filters as the scan
+    std::vector<std::string> ignorePatterns = readPatternFile(".cppsignore");
+    std::map<int, std::string> watchDirs;
+    addWatchDirs(fd, watchDirs, startDir+"src", "src/", ignorePatterns);
+
+    std::cout << "Watching " << watchDirs.size() << " folders in src. Press Ctrl+C to stop." << std::endl;
+
+    alignas(struct inotify_event) char buffer[4096];
+    pollfd pfd = {fd, POLLIN, 0};
+
+    while(true)
+    {
+        //wait for the first event then keep reading until the folder is quiet
+        if(poll(&pfd, 1, -1) <= 0)
+            continue;
+
+        bool sourcesChanged = false;
+        bool filesModified = false;
+
+        do
+        {
+            ssize_t length = read(fd, buffer, sizeof(buffer));
+            if(length <= 0)
+                break;
+            
+            for(char* ptr = buffer; ptr < buffer + length; ptr += sizeof(struct inotify_event) + ((struct inotify_event*)ptr)->len)
+            {
+                struct inotify_event* e = (struct inotify_event*)ptr;
+
+                if(e->mask & IN_Q_OVERFLOW)
+                {
+                    //events were lost so start over from the folder itself
+                    removeWatchDirs(fd, watchDirs, "src/");
+                    addWatchDirs(fd, watchDirs, startDir+"src", "src/", ignorePatterns);
+                    scannedFiles.clear();
+                    addSubDirStuff(scannedFiles, startDir+"/src", "src/");
+                    sourceFiles = std::set<std::string>(scannedFiles.begin(), scannedFiles.end());
+                    sourcesChanged = true;
+                    continue;
+                }
+
+                if(e->mask & IN_IGNORED)
+                {
+                    watchDirs.erase(e->wd);
+                    continue;
+                }
+
+                auto dirIt = watchDirs.find(e->wd);
+                if(dirIt == watchDirs.end() || e->len == 0)
+                    continue;
+
+                std::string path = dirIt->second + e->name;
+
+                if(e->mask & IN_ISDIR)
+                {
+                    if(e->mask & (IN_CREATE | IN_MOVED_TO))
+                    {
+                        if(matchesPatterns(path, e->name, true, ignorePatterns))
+                            continue;
+
+                        std::vector<std::string> newFiles;
+                        addWatchDirs(fd, watchDirs, startDir + path, path + "/", ignorePatterns);
+                        addSubDirStuff(newFiles, startDir + path, path + "/");
+                        sourceFiles.insert(newFiles.begin(), newFiles.end());
+                        sourcesChanged = true;
+                    }
+                    else if(e->mask & (IN_DELETE | IN_MOVED_FROM))
+                    {
+                        std::string prefix = path + "/";
+                        removeWatchDirs(fd, watchDirs, prefix);
+                        for(auto it = sourceFiles.lower_bound(prefix); it != sourceFiles.end() && it->rfind(prefix, 0) == 0;)
+                            it = sourceFiles.erase(it);
+                        sourcesChanged = true;
+                    }
+                }
+                else
+                {
+                    if(e->mask & (IN_CREATE | IN_MOVED_TO))
+                    {
+                        if(isSourceFile(e->name) && !matchesPatterns(path, e->name, false, ignorePatterns))
+                            sourcesChanged |= sourceFiles.insert(path).second;
+                    }
+                    else if(e->mask & (IN_DELETE | IN_MOVED_FROM))
+                        sourcesChanged |= (sourceFiles.erase(path) > 0);
+                    else if(e->mask & IN_CLOSE_WRITE)
+                        filesModified = true;
+                }
+            }
+        }
+        while(poll(&pfd, 1, WATCH_DEBOUNCE_MS) > 0);
+
+        if(sourcesChanged)
+        {
+            std::cout << "Updating .ninja files" << std::endl;
+            createNinjaFile(std::vector<std::string>(sourceFiles.begin(), sourceFiles.end()));
+        }
+
+        if(watchBuild && (sourcesChanged || filesModified))
+        {
+            std::string command = "ninja -C " + startDir + " -f ./build/Debug/build.ninja";
+            system(command.c_str());
+        }
+    }
+
+    close(fd);
+}
+
+#endif
+
+void writeCompileShell(std::ostream& file, int config)
+{
+    if(file.good())
+    {
+        file << "#!/bin/bash\n";
+        
+        //linking is done by ninja so nothing is rebuilt when nothing changed
+        file << "ninja -f ./build/" << getConfigName(config) << "/build.ninja -v\n";
+    }
+}
+
+void makeExecutable(std::string filename)
+{
+    //Note that this is required in linux to create a executable shell file.
+    std::error_code err;
+    fs::permissions(filename, fs::perms::owner_all | fs::perms::group_read | fs::perms::group_exec | fs::perms::others_read | fs::perms::others_exec, err);
+}
+
+void createShellFile()
+{
+    for(int config : getConfigs())
+    {
+        std::stringstream file;
+        writeCompileShell(file, config);
+
+        //a replaced file is a new file so it has to be made executable again
+        std::string filename = startDir + "/build/" + getConfigName(config) + "/build.sh";
+        if(writeFileIfChanged(filename, file.str()) == WRITE_CHANGED)
+            makeExecutable(filename);
+    }
+}
+
+void writeCompileBatch(std::ostream& file, int config)
+{
+    if(file.good())
+    {
+        file << "@echo OFF\n";
+
+        if(includeResourceFile)
+        {
+            if(compilerType == TYPE_MSVC)
+                file << "rc res/";
+            else if(compilerType == TYPE_CLANG)
+                file << "llvm-rc res/";
+            else
+            {
+                std::cout << "ERROR: Can't compile resource file without llvm-rc(CLANG) or rc(MSVC)" << std::endl;
+                std::cout << "Resource file being skipped." << std::endl;
+                includeResourceFile = false;
+            }
+
+            if(includeResourceFile)
+            {
+                file << projectName;
+                file << ".rc\n";
+            }
+        }
+
+        //linking is done by ninja so nothing is rebuilt when nothing changed
+        file << "ninja -f ./build/" << getConfigName(config) << "/build.ninja -v\n";
+    }
+}
+
+void createBatchFile()
+{
+    for(int config : getConfigs())
+    {
+        std::stringstream file;
+        writeCompileBatch(file, config);
+        writeFileIfChanged(startDir + "/build/" + getConfigName(config) + "/build.bat", file.str());
+    }
+}
+
+void createBenchmarkFiles()
+{
+    //an example is only added to an empty bench folder
+    std::error_code err;
+    if(fs::is_empty(startDir + "/bench", err))
+    {
+        std::fstream file(startDir + "/bench/example_bench.cpp", std::fstream::out | std::fstream::binary);
+        file << "#include <benchmark/benchmark.h>\n";
+        file << "#include <vector>\n";
+        file << "\n";
+        file << "static void BM_Example(benchmark::State& state)\n";
+        file << "{\n";
+        file << "    for(auto _ : state)\n";
+        file << "    {\n";
+        file << "        std::vector<int> v(state.range(0));\n";
+        file << "        benchmark::DoNotOptimize(v.data());\n";
+        file << "    }\n";
+        file << "}\n";
+        file << "BENCHMARK(BM_Example)->Arg(1024);\n";
+        file << "\n";
+        file << "BENCHMARK_MAIN();\n";
+        file.close();
+    }
+
+    //results are stored by the commit they were run on so runs can be compared later
+    std::stringstream file;
+    if(generateBatch)
+    {
+        file << "@echo OFF\n";
+        file << "ninja -f ./build/Release/build.ninja bench -v || exit /b 1\n";
+        file << "set commit=nogit\n";
+        file << "for /f %%i in ('git rev-parse --short HEAD 2^>nul') do set commit=%%i\n";
+        file << "if not exist bench\\results mkdir bench\\results\n";
+        file << "\"" << getBenchOutputFile() << "\" --benchmark_repetitions=10 --benchmark_out=bench/results/%commit%.json --benchmark_out_format=json %*\n";
+        writeFileIfChanged(startDir + "/build/Release/run_benchmarks.bat", file.str());
+    }
+    else
+    {
+        file << "#!/bin/bash\n";
+        file << "ninja -f ./build/Release/build.ninja bench -v || exit 1\n";
+        file << "commit=$(git rev-parse --short HEAD 2>/dev/null || echo nogit)\n";
+        file << "if [ -n \"$(git status --porcelain 2>/dev/null)\" ]; then commit=\"$commit-dirty\"; fi\n";
+        file << "mkdir -p bench/results\n";
+        file << getBenchOutputFile() << " --benchmark_repetitions=10 --benchmark_out=bench/results/$commit.json --benchmark_out_format=json \"$@\"\n";
+
+        std::string filename = startDir + "/build/Release/run_benchmarks.sh";
+        if(writeFileIfChanged(filename, file.str()) == WRITE_CHANGED)
+            makeExecutable(filename);
+    }
+}
+
+void addVSCodeOptions()
+{
+    std::string k = "";
+    std::fstream file = std::fstream(".vscode/c_cpp_properties.json", std::fstream::out);
+    if(file.is_open())
+    {
+        file << "{\n";
+        file << "\t\"configurations\": [\n";
+        file << "\t\t{\n";
+        file << "\t\t\t\"name\": \"Clang LLVM\",\n";
+        file << "\t\t\t\"includePath\": [\n";
+        file << "\t\t\t\t\"${workspaceFolder}/include/*\"\n";
+        file << "\t\t\t],\n";
+        file << "\t\t\t\"defines\": [\n";
+        file << "\t\t\t\t\"_DEBUG\",\n";
+        file << "\t\t\t\t\"UNICODE\",\n";
+        file << "\t\t\t\t\"_UNICODE\"\n";
+        file << "\t\t\t],\n";
+
+        #ifndef LINUX
+            file << "\t\t\t\"windowsSdkVersion\": \"10.0.19041.0\",\n";
+        #endif
+
+        file << "\t\t\t\"cStandard\": \"c11\",\n";
+
+        if(compilerType==TYPE_MSVC)
+            file << "\t\t\t\"intelliSenseMode\": \"msvc-x64\",\n";
+        else if(compilerType==TYPE_CLANG)
+            file << "\t\t\t\"intelliSenseMode\": \"clang-x64\",\n";
+        else
+            file << "\t\t\t\"intelliSenseMode\": \"gcc-x64\",\n";
+
+        file << "\t\t\t\"cppStandard\": \"c++17\"\n";
+        file << "\t\t}\n";
+        file << "\t],\n";
+        file << "\t\"version\": 4\n";
+        file << "}";
+        
+        file.close();
+    }
+    
+    std::fstream file2 = std::fstream(".vscode/tasks.json", std::fstream::out);
+    if(file2.is_open())
+    {
+        file2 << "{\n";
+        
+        file2 << "\t\"version\": \"2.0.0\",\n";
+        file2 << "\t\"tasks\": [\n";
+
+        //debug build
+        file2 << "\t\t{\n";
+        file2 << "\t\t\t\"label\": \"Build Debug with Clang\",\n";
+        file2 << "\t\t\t\"type\": \"shell\",\n";
+
+        if(!generateBatch)
+            file2 << "\t\t\t\"command\": \"${workspaceFolder}/build/Debug/build.sh\",\n";
+        else
+            file2 << "\t\t\t\"command\": \"${workspaceFolder}/build/Debug/build.bat\",\n";
+        
+        file2 << "\t\t\t\"group\": {\n";
+        file2 << "\t\t\t\t\"kind\": \"build\",\n";
+        file2 << "\t\t\t\t\"isDefault\": true\n";
+        file2 << "\t\t\t},\n";
+        file2 << "\t\t\t\"problemMatcher\": []\n";
+        file2 << "\t\t},\n";
+
+        //release build
+        file2 << "\t\t{\n";
+        file2 << "\t\t\t\"label\": \"Build Release with Clang\",\n";
+        file2 << "\t\t\t\"type\": \"shell\",\n";
+
+        if(!generateBatch)
+            file2 << "\t\t\t\"command\": \"${workspaceFolder}/build/Release/build.sh\",\n";
+        else
+            file2 << "\t\t\t\"command\": \"${workspaceFolder}/build/Release/build.bat\",\n";
+
+        file2 << "\t\t\t\"group\": {\n";
+        file2 << "\t\t\t\t\"kind\": \"build\",\n";
+        file2 << "\t\t\t\t\"isDefault\": true\n";
+        file2 << "\t\t\t},\n";
+        file2 << "\t\t\t\"problemMatcher\": []\n";
+
+        file2 << "\t\t}\n";
+
+        file2 << "\t]\n";
+
+        file2 << "}\n";
+        file2.close();
+    }
+
+
+    std::fstream file3 = std::fstream(".vscode/launch.json", std::fstream::out);
+
+    if(file3.is_open())
+    {
+        file3 << "{\n";
+
+        file3 << "\t\"version\": \"0.2.0\",\n";
+        file3 << "\t\"configurations\": [\n";
+
+
+        //debug run
+        file3 << "\t\t{\n";
+        file3 << "\t\t\t\"name\": \"(MVSC) Debug Launch\",\n";
+        if(generateBatch)
+            file3 << "\t\t\t\"type\": \"cppvsdbg\",\n";
+        else
+            file3 << "\t\t\t\"type\": \"cppdbg\",\n";
+        
+        file3 << "\t\t\t\"request\": \"launch\",\n";
+
+        if(!generateBatch)
+        {
+            file3 << "\t\t\t\"program\": \"${workspaceFolder}/bin/Debug/" << projectName << "\",\n";
+            file3 << "\t\t\t\"externalConsole\": \"true\",\n";
+            file3 << "\t\t\t\"MIMode\": \"gdb\",\n";
+        }
+        else
+        {
+            file3 << "\t\t\t\"program\": \"${workspaceFolder}/bin/Debug/" << projectName << ".exe\",\n";
+            file3 << "\t\t\t\"console\": \"externalTerminal\",\n";
+        }
+
+        file3 << "\t\t\t\"args\": [],\n";
+        file3 << "\t\t\t\"stopAtEntry\": false,\n";
+        file3 << "\t\t\t\"cwd\": \"${workspaceFolder}\",\n";
+        file3 << "\t\t\t\"environment\": []\n";
+        file3 << "\t\t},\n";
+
+        //release run
+        file3 << "\t\t{\n";
+        file3 << "\t\t\t\"name\": \"(MVSC) Release Launch\",\n";
+        if(generateBatch)
+            file3 << "\t\t\t\"type\": \"cppvsdbg\",\n";
+        else
+            file3 << "\t\t\t\"type\": \"cppdbg\",\n";
+        file3 << "\t\t\t\"request\": \"launch\",\n";
+
+        if(!generateBatch)
+        {
+            file3 << "\t\t\t\"program\": \"${workspaceFolder}/bin/Release/" << projectName << "\",\n";
+            file3 << "\t\t\t\"externalConsole\": \"true\",\n";
+            file3 << "\t\t\t\"MIMode\": \"gdb\",\n";
+        }
+        else
+        {
+            file3 << "\t\t\t\"program\": \"${workspaceFolder}/bin/Release/" << projectName << ".exe\",\n";
+            file3 << "\t\t\t\"console\": \"externalTerminal\",\n";
+        }
+
+        file3 << "\t\t\t\"args\": [],\n";
+        file3 << "\t\t\t\"stopAtEntry\": false,\n";
+        file3 << "\t\t\t\"cwd\": \"${workspaceFolder}\",\n";
+        file3 << "\t\t\t\"environment\": []\n";
+
+        file3 << "\t\t}\n";
+        
+        file3 << "\t]\n";
+
+        file3 << "}";
+        file3.close();
+    }
+}
+
+void addTraceTimes(const JsonValue& events, std::map<std::string, std::pair<double, int>>& headerTimes, std::map<std::string, std::pair<double, int>>& templateTimes)
+{
+    for(const JsonValue& e : events.items)
+    {
+        const JsonValue* name = e.get("name");
+        const JsonValue* dur = e.get("dur");
+        const JsonValue* args = e.get("args");
+        const JsonValue* detail = (args != nullptr)? args->get("detail") : nullptr;
+        if(name == nullptr || dur == nullptr || detail == nullptr)
+            continue;
+        
+        //durations are in microseconds
+        if(name->text == "Source")
+        {
+            headerTimes[detail->text].first += dur->number / 1000.0;
+            headerTimes[detail->text].second++;
+        }
+        else if(name->text == "InstantiateClass" || name->text == "InstantiateFunction")
+        {
+            templateTimes[detail->text].first += dur->number / 1000.0;
+            templateTimes[detail->text].second++;
+        }
+    }
+}
+
+void printLongest(std::string title, const std::map<std::string, std::pair<double, int>>& times, std::string countName)
+{
+    std::vector<std::pair<double, std::string>> sorted;
+    for(const auto& it : times)
+        sorted.push_back({it.second.first, it.first});
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b){ return a.first > b.first; });
+
+    std::cout << std::endl;
+    std::cout << "----------------------------" << std::endl;
+    std::cout << title << std::endl;
+    for(size_t i=0; i<sorted.size() && i<REPORT_COUNT; i++)
+    {
+        std::cout << (long long)sorted[i].first << " ms\t";
+        if(!countName.empty())
+            std::cout << times.at(sorted[i].second).second << " " << countName << "\t";
+        std::cout << sorted[i].second << std::endl;
+    }
+    if(sorted.empty())
+        std::cout << "Nothing found" << std::endl;
+}
+
+bool readNinjaLog(std::map<std::string, std::pair<double, int>>& objectTimes)
+{
+    //.ninja_log lines are "start end mtime output hash" separated by tabs with times in ms.
+    //Later lines for the same output replace older ones.
+    std::fstream logFile(startDir + ".ninja_log", std::fstream::in | std::fstream::binary);
+    std::string line;
+    while(std::getline(logFile, line))
+    {
+        if(line.empty() || line[0] == '#')
+            continue;
+        
+        std::vector<std::string> parts;
+        std::stringstream lineStream(line);
+        std::string part;
+        while(std::getline(lineStream, part, '\t'))
+            parts.push_back(part);
+        
+        if(parts.size() < 5 || parts[3].find("/obj/") == SIZE_MAX)
+            continue;
+        
+        double time = std::atof(parts[1].c_str()) - std::atof(parts[0].c_str());
+        objectTimes[parts[3]] = {time, 1};
+    }
+    return logFile.is_open();
+}
+
+void reportBuildTimes()
+{
+    std::map<std::string, std::pair<double, int>> objectTimes;
+    if(!readNinjaLog(objectTimes))
+        std::cout << "ERROR: Could not find .ninja_log. Build the project with ninja first." << std::endl;
+    
+    //clang writes a .json trace next to each object when -ftime-trace is used
+    std::map<std::string, std::pair<double, int>> headerTimes;
+    std::map<std::string, std::pair<double, int>> templateTimes;
+    int traceCount = 0;
+
+    std::error_code err;
+    for(const fs::directory_entry& configDir : fs::directory_iterator(startDir + "bin", err))
+    {
+        std::string objDir = configDir.path().string() + "/obj";
+        if(!fs::is_directory(objDir, err))
+            continue;
+        
+        for(const fs::directory_entry& f : fs::recursive_directory_iterator(objDir, err))
+        {
+            if(!f.is_regular_file() || f.path().extension() != ".json")
+                continue;
+            
+            JsonValue trace;
+            if(!readJsonFile(f.path().string(), trace))
+                continue;
+            
+            const JsonValue* events = trace.get("traceEvents");
+            if(events != nullptr)
+            {
+                addTraceTimes(*events, headerTimes, templateTimes);
+                traceCount++;
+            }
+        }
+    }
+
+    printLongest("Slowest objects (from .ninja_log):", objectTimes, "");
+    
+    if(traceCount == 0)
+    {
+        std::cout << std::endl;
+        std::cout << "No time traces found. Create the project with -Trace_Build using clang and rebuild to see headers and templates." << std::endl;
+        return;
+    }
+
+    printLongest("Most expensive headers (total parse time including nested headers):", headerTimes, "includes");
+    printLongest("Longest template instantiations (total time):", templateTimes, "times");
+}
+
+bool readBenchmarkTimes(std::string filename, std::map<std::string, std::vector<double>>& times)
+{
+    //Google Benchmark json. Every repetition is its own entry with run_type "iteration".
+    //The aggregates (mean, median, stddev) are skipped since they are computed again here.
+    JsonValue results;
+    if(!readJsonFile(filename, results))
+    {
+        std::cout << "ERROR: Could not read " << filename << std::endl;
+        return false;
+    }
+
+    const JsonValue* benchmarks = results.get("benchmarks");
+    if(benchmarks == nullptr || benchmarks->type != JSON_ARRAY)
+    {
+        std::cout << "ERROR: " << filename << " has no benchmarks" << std::endl;
+        return false;
+    }
+
+    for(const JsonValue& b : benchmarks->items)
+    {
+        const JsonValue* runType = b.get("run_type");
+        if(runType != nullptr && runType->text == "aggregate")
+            continue;
+        
+        const JsonValue* name = b.get("run_name");
+        if(name == nullptr)
+            name = b.get("name");
+        const JsonValue* time = b.get("real_time");
+        if(name == nullptr || time == nullptr)
+            continue;
+        
+        //everything is compared in nanoseconds
+        double scale = 1;
+        const JsonValue* unit = b.get("time_unit");
+        if(unit != nullptr)
+        {
+            if(unit->text == "us")
+                scale = 1e3;
+            else if(unit->text == "ms")
+                scale = 1e6;
+            else if(unit->text == "s")
+                scale = 1e9;
+        }
+        times[name->text].push_back(time->number * scale);
+    }
+    return true;
+}
+
+double getMedian(std::vector<double> values)
+{
+    if(values.empty())
+        return 0;
+    
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size()/2;
+    if(values.size() % 2 == 0)
+        return (values[mid-1] + values[mid]) / 2;
+    return values[mid];
+}
+
+double getMedianDeviation(const std::vector<double>& values, double median)
+{
+    //median absolute deviation scaled so it matches the standard deviation of normal data
+    std::vector<double> deviations;
+    for(double v : values)
+        deviations.push_back(std::abs(v - median));
+    return getMedian(deviations) * 1.4826;
+}
+
+int compareBenchmarks(std::string baselineFile, std::string candidateFile)
+{
+    std::map<std::string, std::vector<double>> baseline;
+    std::map<std::string, std::vector<double>> candidate;
+    if(!readBenchmarkTimes(baselineFile, baseline) || !readBenchmarkTimes(candidateFile, candidate))
+        return 1;
+    
+    int regressions = 0;
+    bool fewRepetitions = false;
+
+    std::cout << "Benchmark\tBaseline ns\tCandidate ns\tChange\tNoise\tResult" << std::endl;
+    for(const auto& it : baseline)
+    {
+        auto other = candidate.find(it.first);
+        if(other == candidate.end())
+        {
+            std::cout << it.first << "\tmissing from " << candidateFile << std::endl;
+            continue;
+        }
+
+        double baseMedian = getMedian(it.second);
+        double candMedian = getMedian(other->second);
+        double baseDeviation = getMedianDeviation(it.second, baseMedian);
+        double candDeviation = getMedianDeviation(other->second, candMedian);
+        if(it.second.size() < 3 || other->second.size() < 3)
+            fewRepetitions = true;
+
+        //a change only counts when it is past the threshold and larger than the spread of both runs
+        double change = (baseMedian > 0)? (candMedian - baseMedian) / baseMedian * 100 : 0;
+        double noise = BENCH_NOISE_SCALE * std::sqrt(baseDeviation*baseDeviation + candDeviation*candDeviation);
+        double noisePercent = (baseMedian > 0)? noise / baseMedian * 100 : 0;
+        bool significant = std::abs(candMedian - baseMedian) > noise;
+
+        std::string result = "same";
+        if(significant && change > benchThreshold)
+        {
+            result = "REGRESSION";
+            regressions++;
+        }
+        else if(significant && change < -benchThreshold)
+        {
+            result = "improved";
+        }
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << it.first << "\t" << baseMedian << "\t" << candMedian << "\t";
+        std::cout << std::showpos << change << "%" << std::noshowpos << "\t+-" << noisePercent << "%\t" << result << std::endl;
+    }
+
+    for(const auto& it : candidate)
+    {
+        if(baseline.find(it.first) == baseline.end())
+            std::cout << it.first << "\tnew in " << candidateFile << std::endl;
+    }
+
+    std::cout << std::endl;
+    if(fewRepetitions)
+        std::cout << "WARNING: Some benchmarks have less than 3 repetitions. Use --benchmark_repetitions for a reliable comparison." << std::endl;
+
+    if(regressions > 0)
+    {
+        std::cout << regressions << " benchmark(s) are more than " << benchThreshold << "% slower" << std::endl;
+        return 1;
+    }
+    
+    std::cout << "No regressions more than " << benchThreshold << "% slower" << std::endl;
+    return 0;
+}
+
+std::string normalizeDepPath(const std::string& path)
+{
+    return fs::path(path).lexically_normal().generic_string();
+}
+
+void readNinjaDeps(int config, std::map<std::string, std::vector<std::string>>& deps)
+{
+    //ninja removes the .d files once they are stored in .ninja_deps so ninja is asked for them.
+    //The output is "object: #deps N, ..." followed by one indented line per dependency.
+    std::string command = "ninja -C \"" + startDir + "\" -f ./build/" + getConfigName(config) + "/build.ninja -t deps";
+    #ifdef LINUX
+        FILE* pipe = popen((command + " 2>/dev/null").c_str(), "r");
+    #else
+        FILE* pipe = _popen((command + " 2>nul").c_str(), "r");
+    #endif
+    if(pipe == nullptr)
+        return;
+    
+    std::string output = "";
+    char buffer[4096];
+    size_t count;
+    while((count = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+        output.append(buffer, count);
+    
+    #ifdef LINUX
+        pclose(pipe);
+    #else
+        _pclose(pipe);
+    #endif
+
+    std::stringstream outputStream(output);
+    std::string line;
+    std::string object = "";
+    while(std::getline(outputStream, line))
+    {
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if(line.empty())
+            continue;
+        
+        if(line[0] != ' ')
+        {
+            object = normalizeDepPath(line.substr(0, line.find(": #deps")));
+            deps[object];
+        }
+        else if(!object.empty())
+        {
+            deps[object].push_back(normalizeDepPath(line.substr(line.find_first_not_of(' '))));
+        }
+    }
+}
+
+void readDepFiles(int config, std::map<std::string, std::vector<std::string>>& deps)
+{
+    //.d files are left when the objects were built without ninja's deps log.
+    //They are makefile rules "object: dep dep \" that can go over several lines.
+    std::error_code err;
+    for(const fs::directory_entry& f : fs::recursive_directory_iterator(startDir + "bin/" + getConfigName(config) + "/obj", err))
+    {
+        if(!f.is_regular_file() || f.path().extension() != ".d")
+            continue;
+        
+        std::fstream file(f.path(), std::fstream::in | std::fstream::binary);
+        std::stringstream content;
+        content << file.rdbuf();
+        std::string text = content.str();
+
+        size_t colon = text.find(": ");
+        if(colon == SIZE_MAX)
+            continue;
         
-        file << compilerName;
-        file << " %debugOptions% %linkOptions% %extraOptions% %projectCommand%";
+        std::string object = normalizeDepPath(text.substr(0, colon));
+        std::vector<std::string>& objectDeps = deps[object];
+        std::stringstream depStream(text.substr(colon+1));
+        std::string dep;
+        while(depStream >> dep)
+        {
+            if(dep != "\\")
+                objectDeps.push_back(normalizeDepPath(dep));
+        }
     }
 }
 
-void createBatchFile()
-{
-    std::fstream file;
-    std::string k;
-
-    //DEBUG
-    file = std::fstream(startDir + "build/Debug/build.bat", std::fstream::out | std::fstream::binary);
-    writeCompileBatch(file, true);
-    file.close();
-
-    //RELEASE
-    file = std::fstream(startDir + "build/Release/build.bat", std::fstream::out | std::fstream::binary);
-    writeCompileBatch(file, false);
-    file.close();
-}
-
-void createStaticLibFiles()
+void analyzeIncludes()
 {
-    if(generateBatch)
+    std::map<std::string, std::vector<std::string>> deps;
+    readNinjaDeps(CONFIG_DEBUG, deps);
+    if(deps.empty())
+        readDepFiles(CONFIG_DEBUG, deps);
+    
+    std::map<std::string, std::pair<double, int>> objectTimes;
+    std::map<std::string, std::pair<double, int>> logTimes;
+    readNinjaLog(logTimes);
+    for(const auto& it : logTimes)
+        objectTimes[normalizeDepPath(it.first)] = it.second;
+    
+    //every project header gets the compile time of the objects that would be rebuilt if it changed
+    std::map<std::string, std::pair<double, int>> headerTimes;
+    int objectCount = 0;
+    int timedCount = 0;
+    for(const auto& it : deps)
     {
-        //buildALL
-        std::fstream file(startDir + "exportStaticLib/exportAllLibs.bat", std::fstream::out | std::fstream::binary);
-        file << "@echo OFF\n";
-
-        file << "llvm-ar -rcs exportStaticLib/Debug/"+projectName+".lib bin/Debug/obj/*.o\n";
-        file << "llvm-ar -rcs exportStaticLib/Release/"+projectName+".lib bin/Release/obj/*.o\n";
-        file << "\n";
-
-        file.close();
+        std::string extension = fs::path(it.first).extension().string();
+        if(extension != ".o" && extension != ".obj")
+            continue;
         
-        //build Debug
-        file = std::fstream(startDir + "exportStaticLib/Debug/exportLib.bat", std::fstream::out | std::fstream::binary);
-        file << "@echo OFF\n";
-        file << "llvm-ar -rcs exportStaticLib/Debug/"+projectName+".lib bin/Debug/obj/*.o\n";
-
-        file.close();
-
-        //build Release
-        file = std::fstream(startDir + "exportStaticLib/Release/exportLib.bat", std::fstream::out | std::fstream::binary);
-        file << "@echo OFF\n";
-        file << "llvm-ar -rcs exportStaticLib/Release/"+projectName+".lib bin/Release/obj/*.o\n";
-
-        file.close();
+        objectCount++;
+        double time = 0;
+        auto timeIt = objectTimes.find(it.first);
+        if(timeIt != objectTimes.end())
+        {
+            time = timeIt->second.first;
+            timedCount++;
+        }
+        for(const std::string& dep : it.second)
+        {
+            if(isSourceFile(dep) || (dep.rfind("include/", 0) != 0 && dep.rfind("src/", 0) != 0))
+                continue;
+            
+            headerTimes[dep].first += time;
+            headerTimes[dep].second++;
+        }
     }
-    else
+
+    if(objectCount == 0)
     {
-        //buildALL
-        std::fstream file(startDir + "exportStaticLib/exportAllLibs.sh", std::fstream::out | std::fstream::binary);
-        file << "#!/bin/bash\n";
+        std::cout << "ERROR: No dependency information was found. Build the Debug build with ninja first." << std::endl;
+        return;
+    }
 
-        file << "llvm-ar -rcs exportStaticLib/Debug/"+projectName+".lib bin/Debug/obj/*.o\n";
-        file << "llvm-ar -rcs exportStaticLib/Release/"+projectName+".lib bin/Release/obj/*.o\n";
-        file << "\n";
+    //the counts below still work without times but the costs would all be 0
+    if(timedCount == 0)
+        std::cout << "WARNING: No object in .ninja_log matched the dependency information so every cost is 0 ms." << std::endl;
 
-        file.close();
-        
-        //build Debug
-        file = std::fstream(startDir + "exportStaticLib/Debug/exportLib.sh", std::fstream::out | std::fstream::binary);
-        file << "#!/bin/bash\n";
-        file << "llvm-ar -rcs exportStaticLib/Debug/"+projectName+".lib bin/Debug/obj/*.o\n";
+    printLongest("Headers with the most compile time behind them (every object that includes them):", headerTimes, "objects");
 
-        file.close();
+    std::vector<std::pair<int, std::string>> sorted;
+    for(const auto& it : headerTimes)
+        sorted.push_back({it.second.second, it.first});
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b){ return a.first > b.first; });
 
-        //build Release
-        file = std::fstream(startDir + "exportStaticLib/Release/exportLib.sh", std::fstream::out | std::fstream::binary);
-        file << "#!/bin/bash\n";
-        file << "llvm-ar -rcs exportStaticLib/Release/"+projectName+".lib bin/Release/obj/*.o\n";
+    std::cout << std::endl;
+    std::cout << "----------------------------" << std::endl;
+    std::cout << "Headers included by the most objects:" << std::endl;
+    for(size_t i=0; i<sorted.size() && i<REPORT_COUNT; i++)
+    {
+        std::cout << "Touching " << sorted[i].second << " rebuilds " << sorted[i].first << " of " << objectCount << " objects";
+        std::cout << " (" << (sorted[i].first * 100 / objectCount) << "%)" << std::endl;
+    }
+    if(sorted.empty())
+        std::cout << "Nothing found" << std::endl;
+}
 
-        file.close();
+int collateModules(std::string ddFile, std::string objDir, std::string compilerTypeName, const std::vector<std::string>& scanFiles)
+{
+    //Reads the p1689 scan of every source and writes a ninja dyndep file so a module is built
+    //before anything that imports it. Each object also gets a response file with the flags
+    //that tell the compiler where the module files are.
+    struct ScanResult
+    {
+        std::string object;
+        std::vector<std::string> provides;
+        std::vector<std::string> imports;
+    };
+
+    std::string extension = ".pcm";
+    if(compilerTypeName == "gcc")
+        extension = ".gcm";
+    else if(compilerTypeName == "msvc")
+        extension = ".ifc";
+    
+    std::vector<ScanResult> results;
+    std::map<std::string, std::string> moduleFiles;
+    std::map<std::string, size_t> providers;
+    for(const std::string& scanFile : scanFiles)
+    {
+        JsonValue scan;
+        if(!readJsonFile(scanFile, scan))
+        {
+            std::cout << "ERROR: Could not read the module scan " << scanFile << std::endl;
+            return 1;
+        }
 
+        const JsonValue* rules = scan.get("rules");
+        if(rules == nullptr)
+            continue;
         
-        //Note that this is required in linux to create a executable shell file.
-        system("chmod 755 exportStaticLib/exportAllLibs.sh");
-        system("chmod 755 exportStaticLib/Debug/exportLib.sh");
-        system("chmod 755 exportStaticLib/Release/exportLib.sh");
+        for(const JsonValue& rule : rules->items)
+        {
+            const JsonValue* output = rule.get("primary-output");
+            if(output == nullptr)
+                continue;
+            
+            ScanResult result;
+            result.object = output->text;
+            const JsonValue* provides = rule.get("provides");
+            const JsonValue* imports = rule.get("requires");
+            if(provides != nullptr)
+            {
+                for(const JsonValue& p : provides->items)
+                {
+                    const JsonValue* name = p.get("logical-name");
+                    if(name == nullptr)
+                        continue;
+                    
+                    result.provides.push_back(name->text);
+                    moduleFiles[name->text] = objDir + "/modules/" + name->text + extension;
+                    providers[name->text] = results.size();
+                }
+            }
+            if(imports != nullptr)
+            {
+                for(const JsonValue& r : imports->items)
+                {
+                    const JsonValue* name = r.get("logical-name");
+                    if(name != nullptr)
+                        result.imports.push_back(name->text);
+                }
+            }
+            results.push_back(result);
+        }
     }
-}
 
-void createDynamicLibFiles()
-{    
-    std::string k = "";
-
-    //clang -shared -I ./include %WLIBPATH32% %WLIBVALUES% bin/debug/x86/obj/*.o -o exportDynamicLib/debug/x64/"projectName".dll
+    std::error_code err;
+    fs::create_directories(objDir + "/modules", err);
 
-    if(generateBatch)
+    std::string dyndep = "ninja_dyndep_version = 1\n";
+    for(const ScanResult& result : results)
     {
-        std::fstream file(startDir + "exportDynamicLib/Debug/exportLib.bat", std::fstream::out | std::fstream::binary);
-        k = "@echo OFF\n";
-        k += compilerName + " ";
-        if(extraDebugOptions)
+        //modules imported by imported modules are needed as well. Modules from outside
+        //of the project (like import std) are left for the compiler to find.
+        std::vector<std::string> needed;
+        std::set<std::string> visited;
+        std::vector<std::string> stack = result.imports;
+        while(!stack.empty())
         {
-            k += "-fsanitize=address ";
+            std::string name = stack.back();
+            stack.pop_back();
+            if(visited.count(name) > 0 || providers.count(name) == 0)
+                continue;
+            
+            visited.insert(name);
+            needed.push_back(name);
+            for(const std::string& next : results[providers[name]].imports)
+                stack.push_back(next);
         }
-        if(includeWindowsStuff)
+
+        std::string modmap = "";
+        dyndep += "build " + result.object;
+        if(!result.provides.empty())
         {
-            if(processorType == PROC_TYPE_32BIT)
-                k += "%WLIBPATH32% %WLIBVALUES% ";
-            else
-                k += "%WLIBPATH64% %WLIBVALUES% ";
+            dyndep += " |";
+            for(const std::string& name : result.provides)
+                dyndep += " " + moduleFiles[name];
         }
-        k += "-shared bin/Debug/obj/*.o ";
-        k += "-o exportDynamicLib/Debug/" + projectName + ".dll";
-        file << k;
-        file.close();
-        
-        file = std::fstream(startDir + "exportDynamicLib/Release/exportLib.bat", std::fstream::out | std::fstream::binary);
-        k = "@echo OFF\n";
-        k += compilerName + " -O3 ";
-        if(includeWindowsStuff)
+        dyndep += ": dyndep";
+        if(!needed.empty())
         {
-            if(processorType == PROC_TYPE_32BIT)
-                k += "%WLIBPATH32% %WLIBVALUES% ";
-            else
-                k += "%WLIBPATH64% %WLIBVALUES% ";
+            dyndep += " |";
+            for(const std::string& name : needed)
+                dyndep += " " + moduleFiles[name];
         }
-        k += "-shared bin/Release/obj/*.o ";
-        k += "-o exportDynamicLib/Release/" + projectName + ".dll";
-        file << k;
-        file.close();
-
-        file = std::fstream(startDir + "exportDynamicLib/exportAllLibs.bat", std::fstream::out | std::fstream::binary);
-        file << "@echo OFF\n";
-        file << "\"./exportDynamicLib/Debug/exportLib.bat\"\n";
-        file << "\n";
-        file << "\"./exportDynamicLib/Release/exportLib.bat\"\n";
+        dyndep += "\n";
 
-        file.close();
-    }
-    else
-    {
-        std::fstream file(startDir + "exportDynamicLib/Debug/exportLib.sh", std::fstream::out | std::fstream::binary);
-        k = "!#/bin/bash\n";
-        k += compilerName + " ";
-        if(extraDebugOptions)
+        if(compilerTypeName == "clang")
         {
-            k += "-fsanitize=address ";
+            if(!result.provides.empty())
+                modmap += "-x c++-module -fmodule-output=" + moduleFiles[result.provides[0]] + "\n";
+            for(const std::string& name : needed)
+                modmap += "-fmodule-file=" + name + "=" + moduleFiles[name] + "\n";
         }
-        if(includeWindowsStuff)
+        else if(compilerTypeName == "gcc")
         {
-            if(processorType == PROC_TYPE_32BIT)
-                k += "%WLIBPATH32% %WLIBVALUES% ";
-            else
-                k += "%WLIBPATH64% %WLIBVALUES% ";
+            modmap += "-x c++ -fmodule-mapper=" + objDir + "/modules.map\n";
         }
-        k += "-shared bin/Debug/obj/*.o ";
-        k += "-o exportDynamicLib/Debug/" + projectName + ".so";
-        file << k;
-        file.close();
-        
-        file = std::fstream(startDir + "exportDynamicLib/Release/exportLib.sh", std::fstream::out | std::fstream::binary);
-        k = "!#/bin/bash\n";
-        k += compilerName + " -O3 ";
-        if(includeWindowsStuff)
+        else
         {
-            if(processorType == PROC_TYPE_32BIT)
-                k += "%WLIBPATH32% %WLIBVALUES% ";
+            if(!result.provides.empty())
+                modmap += "/interface /ifcOutput " + moduleFiles[result.provides[0]] + "\n";
             else
-                k += "%WLIBPATH64% %WLIBVALUES% ";
+                modmap += "/TP\n";
+            for(const std::string& name : needed)
+                modmap += "/reference " + name + "=" + moduleFiles[name] + "\n";
         }
-        k += "-shared bin/Release/obj/*.o ";
-        k += "-o exportDynamicLib/Release/" + projectName + ".so";
-        file << k;
-        file.close();
-
-        file = std::fstream(startDir + "exportDynamicLib/exportAllLibs.sh", std::fstream::out | std::fstream::binary);
-        file << "!#/bin/bash\n";
-        file << "\"./exportDynamicLib/Debug/exportLib.sh\"\n";
-        file << "\n";
-        file << "\"./exportDynamicLib/Release/exportLib.sh\"\n";
+        writeFileIfChanged(result.object + ".modmap", modmap);
+    }
 
-        file.close();
-        
-        //Note that this is required in linux to create a executable shell file.
-        system("chmod 755 exportDynamicLib/exportAllLibs.sh");
-        system("chmod 755 exportDynamicLib/Debug/exportLib.sh");
-        system("chmod 755 exportDynamicLib/Release/exportLib.sh");
+    if(compilerTypeName == "gcc")
+    {
+        std::string mapper = "";
+        for(const auto& it : moduleFiles)
+            mapper += it.first + " " + it.second + "\n";
+        writeFileIfChanged(objDir + "/modules.map", mapper);
     }
+
+    writeFileIfChanged(ddFile, dyndep);
+    return 0;
 }
 
-void addVSCodeOptions()
+std::string escapeDepPath(std::string path)
 {
+    //spaces separate the paths in a depfile and # starts a comment. gcc names its profiles with #
     std::string k = "";
-    std::fstream file = std::fstream(".vscode/c_cpp_properties.json", std::fstream::out);
-    if(file.is_open())
+    for(char c : path)
     {
-        file << "{\n";
-        file << "\t\"configurations\": [\n";
-        file << "\t\t{\n";
-        file << "\t\t\t\"name\": \"Clang LLVM\",\n";
-        file << "\t\t\t\"includePath\": [\n";
-        file << "\t\t\t\t\"${workspaceFolder}/include/*\"\n";
-        file << "\t\t\t],\n";
-        file << "\t\t\t\"defines\": [\n";
-        file << "\t\t\t\t\"_DEBUG\",\n";
-        file << "\t\t\t\t\"UNICODE\",\n";
-        file << "\t\t\t\t\"_UNICODE\"\n";
-        file << "\t\t\t],\n";
+        if(c == ' ' || c == '#')
+            k += '\\';
+        k += c;
+    }
+    return k;
+}
 
-        #ifndef LINUX
-            file << "\t\t\t\"windowsSdkVersion\": \"10.0.19041.0\",\n";
-        #endif
+int mergeProfiles(std::string outputFile, std::string profileDir, std::string compilerTypeName)
+{
+    //Run by the PGO build. clang's .profraw files are merged into outputFile. gcc reads its
+    //.gcda files itself so outputFile only lists them. Either way a depfile with every profile
+    //is written so ninja merges again when the instrumented program is run again.
+    std::string extension = (compilerTypeName == "clang")? ".profraw" : ".gcda";
+    std::vector<std::string> profiles;
+    std::error_code err;
+    for(const fs::directory_entry& f : fs::directory_iterator(profileDir, err))
+    {
+        if(f.path().extension() == extension)
+            profiles.push_back(f.path().generic_string());
+    }
+    std::sort(profiles.begin(), profiles.end());
 
-        file << "\t\t\t\"cStandard\": \"c11\",\n";
+    std::string fileList = "";
+    for(const std::string& profile : profiles)
+        fileList += profile + "\n";
 
-        if(compilerType==TYPE_MSVC)
-            file << "\t\t\t\"intelliSenseMode\": \"msvc-x64\",\n";
-        else if(compilerType==TYPE_CLANG)
-            file << "\t\t\t\"intelliSenseMode\": \"clang-x64\",\n";
-        else
-            file << "\t\t\t\"intelliSenseMode\": \"gcc-x64\",\n";
+    if(compilerTypeName == "clang")
+    {
+        if(profiles.empty())
+        {
+            std::cout << "ERROR: No profiles found in " << profileDir << ". Run the Instrumented build first." << std::endl;
+            return 1;
+        }
 
-        file << "\t\t\t\"cppStandard\": \"c++17\"\n";
-        file << "\t\t}\n";
-        file << "\t],\n";
-        file << "\t\"version\": 4\n";
-        file << "}";
-        
-        file.close();
+        std::string command = "llvm-profdata merge -output=\"" + outputFile + "\"";
+        for(const std::string& profile : profiles)
+            command += " \"" + profile + "\"";
+        if(system(command.c_str()) != 0)
+            return 1;
     }
-    
-    std::fstream file2 = std::fstream(".vscode/tasks.json", std::fstream::out);
-    if(file2.is_open())
+    else
     {
-        file2 << "{\n";
-        
-        file2 << "\t\"version\": \"2.0.0\",\n";
-        file2 << "\t\"tasks\": [\n";
-
-        //debug build
-        file2 << "\t\t{\n";
-        file2 << "\t\t\t\"label\": \"Build Debug with Clang\",\n";
-        file2 << "\t\t\t\"type\": \"shell\",\n";
-
-        if(!generateBatch)
-            file2 << "\t\t\t\"command\": \"${workspaceFolder}/build/Debug/build.sh\",\n";
-        else
-            file2 << "\t\t\t\"command\": \"${workspaceFolder}/build/Debug/build.bat\",\n";
-        
-        file2 << "\t\t\t\"group\": {\n";
-        file2 << "\t\t\t\t\"kind\": \"build\",\n";
-        file2 << "\t\t\t\t\"isDefault\": true\n";
-        file2 << "\t\t\t},\n";
-        file2 << "\t\t\t\"problemMatcher\": []\n";
-        file2 << "\t\t},\n";
-
-        //release build
-        file2 << "\t\t{\n";
-        file2 << "\t\t\t\"label\": \"Build Release with Clang\",\n";
-        file2 << "\t\t\t\"type\": \"shell\",\n";
-
-        if(!generateBatch)
-            file2 << "\t\t\t\"command\": \"${workspaceFolder}/build/Release/build.sh\",\n";
-        else
-            file2 << "\t\t\t\"command\": \"${workspaceFolder}/build/Release/build.bat\",\n";
-
-        file2 << "\t\t\t\"group\": {\n";
-        file2 << "\t\t\t\t\"kind\": \"build\",\n";
-        file2 << "\t\t\t\t\"isDefault\": true\n";
-        file2 << "\t\t\t},\n";
-        file2 << "\t\t\t\"problemMatcher\": []\n";
-
-        file2 << "\t\t}\n";
+        //sources without a profile are still built so an empty list is fine
+        std::fstream file(outputFile, std::fstream::out | std::fstream::binary);
+        file << fileList;
+        file.close();
+    }
 
-        file2 << "\t]\n";
+    std::fstream depFile(outputFile + ".d", std::fstream::out | std::fstream::binary);
+    depFile << escapeDepPath(outputFile) << ":";
+    for(const std::string& profile : profiles)
+        depFile << " " << escapeDepPath(profile);
+    depFile << "\n";
+    depFile.close();
+    return 0;
+}
 
-        file2 << "}\n";
-        file2.close();
+void checkOptions()
+{
+    //turns off options that can not be used with the compiler type
+    if(profileGuided && compilerType == TYPE_MSVC)
+    {
+        std::cout << "ERROR: -PGO is only supported for CLANG and GCC." << std::endl;
+        std::cout << "Instrumented and PGO builds being skipped." << std::endl;
+        profileGuided = false;
     }
 
+    if(archType == ARCH_MULTI && useModules)
+    {
+        std::cout << "ERROR: -ARCH multi can not be used with -Modules." << std::endl;
+        std::cout << "Using the default instruction set instead." << std::endl;
+        archType = ARCH_DEFAULT;
+    }
 
-    std::fstream file3 = std::fstream(".vscode/launch.json", std::fstream::out);
-
-    if(file3.is_open())
+    if(archType == ARCH_MULTI && compilerType == TYPE_MSVC)
     {
-        file3 << "{\n";
+        std::cout << "ERROR: -ARCH multi is only supported for CLANG and GCC." << std::endl;
+        std::cout << "Using the default instruction set instead." << std::endl;
+        archType = ARCH_DEFAULT;
+    }
 
-        file3 << "\t\"version\": \"0.2.0\",\n";
-        file3 << "\t\"configurations\": [\n";
+    if(compilerCacheType != CACHE_NONE && !isProgramOnPath(getCompilerLauncher().substr(0, getCompilerLauncher().size()-1)))
+    {
+        std::cout << "WARNING: " << getCompilerLauncher() << "was not found on the PATH." << std::endl;
+    }
 
+    if(linkerType == LINKER_AUTO)
+    {
+        linkerType = findLinker();
+        linkerFound = true;
+        if(linkerType == LINKER_MOLD)
+            std::cout << "Using the mold linker" << std::endl;
+        else if(linkerType == LINKER_LLD)
+            std::cout << "Using the lld linker" << std::endl;
+        else if(linkerType == LINKER_GOLD)
+            std::cout << "Using the gold linker" << std::endl;
+    }
+}
 
-        //debug run
-        file3 << "\t\t{\n";
-        file3 << "\t\t\t\"name\": \"(MVSC) Debug Launch\",\n";
-        if(generateBatch)
-            file3 << "\t\t\t\"type\": \"cppvsdbg\",\n";
-        else
-            file3 << "\t\t\t\"type\": \"cppdbg\",\n";
-        
-        file3 << "\t\t\t\"request\": \"launch\",\n";
+#ifdef LINUX
 
-        if(!generateBatch)
-        {
-            file3 << "\t\t\t\"program\": \"${workspaceFolder}/bin/Debug/" << projectName << "\",\n";
-            file3 << "\t\t\t\"externalConsole\": \"true\",\n";
-            file3 << "\t\t\t\"MIMode\": \"gdb\",\n";
-        }
-        else
+void createBenchmarkTree(std::string dir, int fileCount, int depth)
+{
+    //50 sources in each folder at the bottom of a tree with the given depth.
+    //Some headers and text files are mixed in so the scan has something to skip.
+    const int filesPerDir = 50;
+    int leafCount = (fileCount + filesPerDir - 1) / filesPerDir;
+    int branches = max((int)std::ceil(std::pow(leafCount, 1.0 / depth)), 1);
+
+    fs::create_directories(dir + "/src");
+    std::fstream mainFile(dir + "/src/main.cpp", std::fstream::out | std::fstream::binary);
+    mainFile << "int main()\n{\n    return 0;\n}\n";
+    mainFile.close();
+
+    for(int i=1; i<fileCount; i++)
+    {
+        int leaf = i / filesPerDir;
+        std::string path = dir + "/src";
+        for(int level=0; level<depth; level++)
         {
-            file3 << "\t\t\t\"program\": \"${workspaceFolder}/bin/Debug/" << projectName << ".exe\",\n";
-            file3 << "\t\t\t\"console\": \"externalTerminal\",\n";
+            path += "/d" + std::to_string(leaf % branches);
+            leaf /= branches;
         }
+        fs::create_directories(path);
 
-        file3 << "\t\t\t\"args\": [],\n";
-        file3 << "\t\t\t\"stopAtEntry\": false,\n";
-        file3 << "\t\t\t\"cwd\": \"${workspaceFolder}\",\n";
-        file3 << "\t\t\t\"environment\": []\n";
-        file3 << "\t\t},\n";
-
-        //release run
-        file3 << "\t\t{\n";
-        file3 << "\t\t\t\"name\": \"(MVSC) Release Launch\",\n";
-        if(generateBatch)
-            file3 << "\t\t\t\"type\": \"cppvsdbg\",\n";
-        else
-            file3 << "\t\t\t\"type\": \"cppdbg\",\n";
-        file3 << "\t\t\t\"request\": \"launch\",\n";
+        std::string extension = (i % 10 == 0)? ".h" : (i % 25 == 0)? ".txt" : ".cpp";
+        std::fstream file(path + "/f" + std::to_string(i) + extension, std::fstream::out | std::fstream::binary);
+        file << "int f" << i << "()\n{\n    return " << i << ";\n}\n";
+    }
+}
 
-        if(!generateBatch)
-        {
-            file3 << "\t\t\t\"program\": \"${workspaceFolder}/bin/Release/" << projectName << "\",\n";
-            file3 << "\t\t\t\"externalConsole\": \"true\",\n";
-            file3 << "\t\t\t\"MIMode\": \"gdb\",\n";
-        }
-        else
-        {
-            file3 << "\t\t\t\"program\": \"${workspaceFolder}/bin/Release/" << projectName << ".exe\",\n";
-            file3 << "\t\t\t\"console\": \"externalTerminal\",\n";
-        }
+long long getReadWriteCalls()
+{
+    //only counts read() and write() calls. Reading folders and stat are not in /proc/self/io
+    //so the folders read by the scan are printed next to it. strace -c shows every kind of call.
+    std::fstream file("/proc/self/io", std::fstream::in);
+    std::string name;
+    long long value;
+    long long total = 0;
+    while(file >> name >> value)
+    {
+        if(name == "syscr:" || name == "syscw:")
+            total += value;
+    }
+    return total;
+}
 
-        file3 << "\t\t\t\"args\": [],\n";
-        file3 << "\t\t\t\"stopAtEntry\": false,\n";
-        file3 << "\t\t\t\"cwd\": \"${workspaceFolder}\",\n";
-        file3 << "\t\t\t\"environment\": []\n";
+double getMilliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
 
-        file3 << "\t\t}\n";
+void runGeneratorBenchmark(int maxFiles)
+{
+    //Each case runs in a child process so its peak memory and system calls are its own.
+    //The tree is made by the parent first so only the generator is measured.
+    std::string benchDir = (fs::temp_directory_path() / "cppps_bench").string();
+    projectName = "bench";
+    
+    std::cout << "Files\tDepth\tCreate ms\tScan ms\tGenerate ms\tUpdate ms\tFolders read\tPeak RSS KB\tread()/write() calls" << std::endl;
+    for(int fileCount : {1000, 10000, 100000})
+    {
+        if(fileCount > maxFiles)
+            break;
         
-        file3 << "\t]\n";
+        for(int depth : {1, 4})
+        {
+            std::error_code err;
+            fs::remove_all(benchDir, err);
+            createBenchmarkTree(benchDir, fileCount, depth);
+            startDir = benchDir + "/";
+
+            //folders changed in the last few seconds are always read again by -u so
+            //the tree is made to look older to measure the normal update
+            fs::file_time_type oldTime = fs::file_time_type::clock::now() - std::chrono::hours(1);
+            fs::last_write_time(benchDir + "/src", oldTime, err);
+            for(const fs::directory_entry& f : fs::recursive_directory_iterator(benchDir + "/src", err))
+            {
+                if(f.is_directory(err))
+                    fs::last_write_time(f.path(), oldTime, err);
+            }
 
-        file3 << "}";
-        file3.close();
+            int pipeFds[2];
+            if(pipe(pipeFds) != 0)
+            {
+                std::cout << "ERROR: Could not create a pipe for the benchmark" << std::endl;
+                return;
+            }
+            
+            std::cout.flush();
+            pid_t pid = fork();
+            if(pid == 0)
+            {
+                close(pipeFds[0]);
+                std::stringstream nullStream;
+                std::streambuf* oldBuffer = std::cout.rdbuf(nullStream.rdbuf());
+                
+                auto t0 = std::chrono::steady_clock::now();
+                createDirectories();
+                auto t1 = std::chrono::steady_clock::now();
+                std::vector<std::string> sourceFiles;
+                dirIndexFilter = getSourceFilter();
+                addSubDirStuff(sourceFiles, startDir+"/src", "src/", &dirIndex);
+                std::sort(sourceFiles.begin(), sourceFiles.end());
+                auto t2 = std::chrono::steady_clock::now();
+                createNinjaVarFile();
+                createNinjaFile(sourceFiles);
+                writeStateFile();
+                auto t3 = std::chrono::steady_clock::now();
+                
+                //the same work that -u does after one source was added. Only its folder is read again.
+                std::string changedDir = fs::path(startDir + sourceFiles.back()).parent_path().string();
+                std::fstream newFile(changedDir + "/added.cpp", std::fstream::out | std::fstream::binary);
+                newFile << "int added()\n{\n    return 0;\n}\n";
+                newFile.close();
+                dirIndex.clear();
+                readStateFile(true);
+                checkOptions();
+                createNinjaVarFile();
+                size_t foldersRead = createNinjaFile();
+                auto t4 = std::chrono::steady_clock::now();
+
+                std::cout.rdbuf(oldBuffer);
+                std::stringstream result;
+                result << std::fixed << std::setprecision(1);
+                result << getMilliseconds(t0, t1) << "\t\t" << getMilliseconds(t1, t2) << "\t" << getMilliseconds(t2, t3) << "\t\t" << getMilliseconds(t3, t4);
+                result << "\t\t" << foldersRead << "/" << dirIndex.size();
+                result << "\t\t" << getReadWriteCalls();
+                std::string text = result.str();
+                if(write(pipeFds[1], text.c_str(), text.size()) < 0)
+                    _exit(1);
+                _exit(0);
+            }
+
+            close(pipeFds[1]);
+            std::string text = "";
+            char buffer[256];
+            ssize_t count;
+            while((count = read(pipeFds[0], buffer, sizeof(buffer))) > 0)
+                text.append(buffer, count);
+            close(pipeFds[0]);
+
+            int status = 0;
+            struct rusage usage = {};
+            wait4(pid, &status, 0, &usage);
+
+            //the syscall count goes last so the peak memory is put before it
+            size_t lastTab = text.find_last_of('\t');
+            if(lastTab == SIZE_MAX)
+            {
+                std::cout << fileCount << "\t" << depth << "\tERROR: The benchmark did not finish" << std::endl;
+                continue;
+            }
+            std::cout << fileCount << "\t" << depth << "\t" << text.substr(0, lastTab) << "\t\t" << usage.ru_maxrss << "\t\t" << text.substr(lastTab+1) << std::endl;
+        }
     }
+
+    std::error_code err;
+    fs::remove_all(benchDir, err);
 }
 
+#endif
+
 int main(int argc, const char* argv[])
 {
     bool valid = true;
     bool update = false;
+    bool watch = false;
+    bool resetOptions = false;
+    bool reportTimes = false;
+    bool includeReport = false;
+    std::string baselineBench = "";
+    std::string candidateBench = "";
+
+    //an absolute path so the build files can run this tool from any folder
+    std::error_code err;
+    #ifdef LINUX
+        toolPath = fs::read_symlink("/proc/self/exe", err).string();
+    #endif
+    if(toolPath.empty() || err)
+        toolPath = (std::string(argv[0]).find_first_of("/\\") != SIZE_MAX)? fs::absolute(argv[0]).string() : argv[0];
 
     if(argc>1)
     {
         int i=1;
         while(i<argc)
         {
+            givenOptions.insert(argv[i]);
+
             if( std::strcmp("-help", argv[i]) == 0 || std::strcmp("-h", argv[i]) == 0)
             {
                 helpFunc();
@@ -1240,10 +4142,155 @@ int main(int argc, const char* argv[])
                 
                 return 0;
             }
+            else if(std::strcmp("-report-build-times", argv[i]) == 0)
+            {
+                reportTimes = true;
+            }
+            else if(std::strcmp("-analyze-includes", argv[i]) == 0)
+            {
+                includeReport = true;
+            }
+            else if(std::strcmp("-bench-generator", argv[i]) == 0)
+            {
+                #ifdef LINUX
+                    //an optional limit for the largest tree
+                    int maxFiles = 100000;
+                    if(i+1 < argc && std::atoi(argv[i+1]) > 0)
+                        maxFiles = std::atoi(argv[i+1]);
+                    checkOptions();
+                    runGeneratorBenchmark(maxFiles);
+                #else
+                    std::cout << "This option (-bench-generator) is only avaliable on Linux currently." << std::endl;
+                #endif
+                return 0;
+            }
+            else if(std::strcmp("-compare-bench", argv[i]) == 0)
+            {
+                if(i+2 < argc)
+                {
+                    baselineBench = argv[i+1];
+                    candidateBench = argv[i+2];
+                    i+=2;
+                }
+                else
+                {
+                    valid = false;
+                    break;
+                }
+            }
+            else if(std::strcmp("-threshold", argv[i]) == 0)
+            {
+                if(i+1 < argc)
+                {
+                    benchThreshold = std::atof(argv[i+1]);
+                    i++;
+                }
+                else
+                {
+                    valid = false;
+                    break;
+                }
+            }
             else if(std::strcmp("-u", argv[i]) == 0)
             {
                 update = true;
             }
+            else if(std::strcmp("-Reset_Options", argv[i]) == 0)
+            {
+                resetOptions = true;
+            }
+            else if(std::strcmp("-watch", argv[i]) == 0)
+            {
+                #ifdef LINUX
+                    update = true;
+                    watch = true;
+                #else
+                    std::cout << "This option (-watch) is only avaliable on Linux currently." << std::endl;
+                    return 0;
+                #endif
+            }
+            else if(std::strcmp("-LTO", argv[i]) == 0)
+            {
+                ltoType = LTO_FULL;
+            }
+            else if(std::strcmp("-ThinLTO", argv[i]) == 0)
+            {
+                ltoType = LTO_THIN;
+            }
+            else if(std::strcmp("-Linker", argv[i]) == 0)
+            {
+                if(i+1 < argc)
+                {
+                    std::string tempName = argv[i+1];
+                    i++;
+
+                    if(tempName=="lld")
+                    {
+                        linkerType = LINKER_LLD;
+                    }
+                    else if(tempName=="mold")
+                    {
+                        linkerType = LINKER_MOLD;
+                    }
+                    else if(tempName=="gold")
+                    {
+                        linkerType = LINKER_GOLD;
+                    }
+                    else if(tempName=="default")
+                    {
+                        linkerType = LINKER_DEFAULT;
+                    }
+                    else
+                    {
+                        valid = false;
+                        break;
+                    }
+                }
+                else
+                {
+                    valid = false;
+                    break;
+                }
+            }
+            else if(std::strcmp("-Cache", argv[i]) == 0)
+            {
+                if(i+1 < argc)
+                {
+                    std::string tempName = argv[i+1];
+                    i++;
+
+                    if(tempName=="ccache")
+                    {
+                        compilerCacheType = CACHE_CCACHE;
+                    }
+                    else if(tempName=="sccache")
+                    {
+                        compilerCacheType = CACHE_SCCACHE;
+                    }
+                    else
+                    {
+                        valid = false;
+                        break;
+                    }
+                }
+                else
+                {
+                    valid = false;
+                    break;
+                }
+            }
+            else if(std::strcmp("-Trace_Build", argv[i]) == 0)
+            {
+                traceBuild = true;
+            }
+            else if(std::strcmp("-PGO", argv[i]) == 0)
+            {
+                profileGuided = true;
+            }
+            else if(std::strcmp("-Watch_Build", argv[i]) == 0)
+            {
+                watchBuild = true;
+            }
             else if(std::strcmp("-f", argv[i]) == 0)
             {
                 //setDirectory
@@ -1296,6 +4343,73 @@ int main(int argc, const char* argv[])
             {
                 extraDebugOptions = true;
             }
+            else if(std::strcmp("-Benchmarks", argv[i]) == 0)
+            {
+                includeBenchmarks = true;
+            }
+            else if(std::strcmp("-Fast_Debug", argv[i]) == 0)
+            {
+                fastDebugOptions = true;
+            }
+            else if(std::strcmp("-Modules", argv[i]) == 0)
+            {
+                useModules = true;
+            }
+            else if(std::strcmp("-Link_Jobs", argv[i]) == 0)
+            {
+                if(i+1 < argc && std::atoi(argv[i+1]) > 0)
+                {
+                    linkJobs = std::atoi(argv[i+1]);
+                    i++;
+                }
+                else
+                {
+                    valid = false;
+                    break;
+                }
+            }
+            else if(std::strcmp("-Heavy_Jobs", argv[i]) == 0)
+            {
+                if(i+1 < argc && std::atoi(argv[i+1]) > 0)
+                {
+                    heavyJobs = std::atoi(argv[i+1]);
+                    i++;
+                }
+                else
+                {
+                    valid = false;
+                    break;
+                }
+            }
+            else if(std::strcmp("-collate-modules", argv[i]) == 0)
+            {
+                //run by the build files. Not meant to be used directly
+                if(i+3 < argc)
+                {
+                    std::vector<std::string> scanFiles;
+                    for(int j=i+4; j<argc; j++)
+                        scanFiles.push_back(argv[j]);
+                    return collateModules(argv[i+1], argv[i+2], argv[i+3], scanFiles);
+                }
+                else
+                {
+                    valid = false;
+                    break;
+                }
+            }
+            else if(std::strcmp("-merge-profiles", argv[i]) == 0)
+            {
+                //run by the build files. Not meant to be used directly
+                if(i+3 < argc)
+                {
+                    return mergeProfiles(argv[i+1], argv[i+2], argv[i+3]);
+                }
+                else
+                {
+                    valid = false;
+                    break;
+                }
+            }
             else if(std::strcmp("-Dynamic_Library", argv[i]) == 0)
             {
                 isDynamicLibrary = true;
@@ -1316,6 +4430,38 @@ int main(int argc, const char* argv[])
             {
                 includeResourceFile = true;
             }
+            else if(std::strcmp("-Unity_Build", argv[i]) == 0)
+            {
+                if(i+1 < argc)
+                {
+                    unityBuildCount = std::atoi(argv[i+1]);
+                    i++;
+
+                    if(unityBuildCount <= 0)
+                    {
+                        valid = false;
+                        break;
+                    }
+                }
+                else
+                {
+                    valid = false;
+                    break;
+                }
+            }
+            else if(std::strcmp("-PCH", argv[i]) == 0)
+            {
+                if(i+1 < argc)
+                {
+                    pchHeader = argv[i+1];
+                    i++;
+                }
+                else
+                {
+                    valid = false;
+                    break;
+                }
+            }
             else if(std::strcmp("-32BIT", argv[i]) == 0)
             {
                 processorType = PROC_TYPE_32BIT;
@@ -1324,6 +4470,45 @@ int main(int argc, const char* argv[])
             {
                 processorType = PROC_TYPE_64BIT;
             }
+            else if(std::strcmp("-ARCH", argv[i]) == 0)
+            {
+                if(i+1 < argc)
+                {
+                    std::string tempName = argv[i+1];
+                    i++;
+
+                    if(tempName=="native")
+                    {
+                        archType = ARCH_NATIVE;
+                    }
+                    else if(tempName=="x86-64-v2")
+                    {
+                        archType = ARCH_X86_64_V2;
+                    }
+                    else if(tempName=="x86-64-v3")
+                    {
+                        archType = ARCH_X86_64_V3;
+                    }
+                    else if(tempName=="x86-64-v4")
+                    {
+                        archType = ARCH_X86_64_V4;
+                    }
+                    else if(tempName=="multi")
+                    {
+                        archType = ARCH_MULTI;
+                    }
+                    else
+                    {
+                        valid = false;
+                        break;
+                    }
+                }
+                else
+                {
+                    valid = false;
+                    break;
+                }
+            }
             else if(std::strcmp("-GENERAL_PROCESSOR", argv[i]) == 0)
             {
                 processorType = PROC_TYPE_UNKNOWN;
@@ -1337,8 +4522,10 @@ int main(int argc, const char* argv[])
 
                     if(compilerTypeSet==false)
                     {
-                        int indexOfSeparator = max(compilerName.find_last_of('/'), compilerName.find_last_of('\\'));
-                        std::string tempName = compilerName.substr(indexOfSeparator);
+                        size_t indexOfSeparator = compilerName.find_last_of("/\\");
+                        std::string tempName = compilerName;
+                        if(indexOfSeparator != SIZE_MAX)
+                            tempName = compilerName.substr(indexOfSeparator+1);
                         if(tempName=="clang" || tempName=="clang++")
                         {
                             compilerType = TYPE_CLANG;
@@ -1408,6 +4595,26 @@ int main(int argc, const char* argv[])
     {
         std::cout << "Incorrect usage of commands" << std::endl;
     }
+    else if(!baselineBench.empty())
+    {
+        return compareBenchmarks(baselineBench, candidateBench);
+    }
+    else if(reportTimes || includeReport)
+    {
+        if(startDir=="")
+        {
+            startDir = "./";
+        }
+        else
+        {
+            startDir += "/";
+        }
+
+        if(reportTimes)
+            reportBuildTimes();
+        if(includeReport)
+            analyzeIncludes();
+    }
     else
     {
         //update or create new project
@@ -1427,9 +4634,17 @@ int main(int argc, const char* argv[])
                 startDir += "/";
             }
 
+            checkOptions();
+
             std::cout << "Creating directories" << std::endl;
             createDirectories();
 
+            if(includeBenchmarks==true)
+            {
+                std::cout << "Creating files for benchmarks" << std::endl;
+                createBenchmarkFiles();
+            }
+
             std::cout << "Creating .ninja files" << std::endl;
             
             createNinjaVarFile();
@@ -1449,18 +4664,6 @@ int main(int argc, const char* argv[])
                 createShellFile();
             }
 
-            if(isStaticLibrary==true)
-            {
-                std::cout << "Creating files for static library building" << std::endl;
-                createStaticLibFiles();
-            }
-
-            if(isDynamicLibrary==true)
-            {
-                std::cout << "Creating files for dynamic library building" << std::endl;
-                createDynamicLibFiles();
-            }
-
             if(vscodeOptions==true)
             {
                 std::cout << "Creating vscode files" << std::endl;
@@ -1469,8 +4672,8 @@ int main(int argc, const char* argv[])
         }
         else
         {
-            //only have to recreate these. These files contain
-            //the files that need to be built.
+            //only the generated files are made again. The sources and
+            //resource files of the project are left alone.
             if(startDir=="")
             {
                 startDir = "./";
@@ -1479,10 +4682,55 @@ int main(int argc, const char* argv[])
             {
                 startDir += "/";
             }
-            std::cout << "Updating .ninja files" << std::endl;
-            
-            getCompilerType();
-            createNinjaFile();
+
+            //.cppps/state has every option the project was made with. Options given
+            //here replace the saved ones and every generated file is made again with them.
+            if(readStateFile(!resetOptions))
+            {
+                checkOptions();
+                createDirectories();
+
+                if(includeBenchmarks==true)
+                    createBenchmarkFiles();
+
+                std::cout << "Updating .ninja files" << std::endl;
+                createNinjaVarFile();
+                createNinjaFile();
+
+                if(generateBatch)
+                    createBatchFile();
+                else
+                    createShellFile();
+            }
+            else
+            {
+                //projects made before the state file existed. Get what is possible from the files
+                //and only update build.ninja since vars.ninja may have options that can not be found.
+                std::cout << "WARNING: No .cppps/state was found. The options were guessed from the build files." << std::endl;
+                std::cout << "Give any missing options with -u once and they are kept from then on." << std::endl;
+                std::cout << "Updating .ninja files" << std::endl;
+
+                //the library folders are made when the project is created with the library options
+                std::error_code err;
+                isStaticLibrary = isStaticLibrary || fs::is_directory(startDir + "exportStaticLib", err);
+                isDynamicLibrary = isDynamicLibrary || fs::is_directory(startDir + "exportDynamicLib", err);
+
+                //the project name is kept in the output file of vars.ninja and
+                //the module scanner is only there when the project uses modules
+                std::map<std::string, std::string> vars = readNinjaVars(startDir + "build/Debug/vars.ninja");
+                if(projectName == "")
+                    projectName = fs::path(vars["outputFile"]).stem().string();
+                useModules = useModules || vars.count("moduleScanner") > 0;
+                
+                getCompilerType();
+                checkOptions();
+                createNinjaFile();
+            }
+
+            #ifdef LINUX
+                if(watch)
+                    watchProject();
+            #endif
         }
         
     }